@@ -0,0 +1,385 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "physics/array.h"
+#include "physics/batch.h"
+#include "physics/body.h"
+#include "physics/collision.h"
+#include "physics/constraint.h"
+#include "physics/shape.h"
+#include "physics/solver.h"
+#include "physics/table.h"
+#include "physics/vec2.h"
+#include "physics/world.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// headless micro benchmarks of the physics kernels, run with `make bench`
+
+#define BENCH_PAIRS 1024
+#define BENCH_KEYS (1 << 17)
+#define BENCH_WORLD_COLUMNS 32 // the world is a wall of BENCH_WORLD_COLUMNS^2 boxes resting on the ground
+#define BENCH_BATCH_WORLDS 256
+#define BENCH_BATCH_COLUMNS 4 // each world of the batch is a wall of BENCH_BATCH_COLUMNS^2 boxes
+#define BENCH_MIN_SECONDS 0.25
+
+// runs the kernel once over all its inputs and returns the number of operations done
+typedef uint32_t BenchFn(void);
+
+typedef struct {
+    Body circles[2 * BENCH_PAIRS];
+    Body boxes[2 * BENCH_PAIRS];
+    Body polygons[2 * BENCH_PAIRS];
+    Body containers[BENCH_PAIRS];
+    BodyArray bodies; // circles, used by the constraints
+    SolverBodyArray solver_bodies;
+    PenetrationConstraint penetrations[BENCH_PAIRS];
+    JointConstraint joints[BENCH_PAIRS];
+    Pair keys[BENCH_KEYS];
+    Table table;
+    World world;
+    WorldSnapshot snapshot;
+    WorldBatch batch;
+} BenchData;
+
+static BenchData data;
+static volatile uint32_t sink; // keeps the compiler from removing the kernels
+
+static uint32_t rng_state = 0x9E3779B9;
+
+// xorshift32
+static uint32_t bench_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static float bench_random(float min, float max) {
+    return min + (max - min) * (float) (bench_next() >> 8) / (float) (1 << 24);
+}
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static void bench_run(const char* name, BenchFn* fn) {
+    fn(); // warm up
+    uint64_t ops = 0;
+    double start = bench_now();
+    double elapsed;
+    do {
+        ops += fn();
+        elapsed = bench_now() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+    printf("%-44s %10.2f ns/op %10.2f Mops/s\n", name, elapsed * 1e9 / (double) ops, (double) ops / elapsed * 1e-6);
+}
+
+// rotated shapes next to each other, about half of the pairs are colliding
+static void bench_place_pair(Body* a, Body* b) {
+    float angle = bench_random(0.0f, 6.2831853f);
+    float distance = bench_random(0.5f, 1.5f);
+    a->position = VEC2(bench_random(-10.0f, 10.0f), bench_random(-10.0f, 10.0f));
+    b->position = vec2_add(a->position, VEC2(cosf(angle) * distance, sinf(angle) * distance));
+    body_set_rotation(a, bench_random(0.0f, 6.2831853f));
+    body_set_rotation(b, bench_random(0.0f, 6.2831853f));
+}
+
+static void bench_init(void) {
+    for (uint32_t i = 0; i < BENCH_PAIRS; i++) {
+        Body* a = &data.circles[2 * i];
+        Body* b = &data.circles[2 * i + 1];
+        body_init_circle(a, 0.5f, 0, 0, 1.0f);
+        body_init_circle(b, 0.5f, 0, 0, 1.0f);
+        bench_place_pair(a, b);
+
+        a = &data.boxes[2 * i];
+        b = &data.boxes[2 * i + 1];
+        body_init_box(a, 1.0f, 1.0f, 0, 0, 1.0f);
+        body_init_box(b, 1.0f, 1.0f, 0, 0, 1.0f);
+        bench_place_pair(a, b);
+
+        // hexagon and box, for polygon vs circle the circle is the other body of the circle pair
+        Vec2Array vertices = DA_NULL;
+        for (int v = 0; v < 6; v++) {
+            DA_APPEND(&vertices, VEC2(0.5f * cosf((float) v * 1.0471976f), 0.5f * sinf((float) v * 1.0471976f)));
+        }
+        a = &data.polygons[2 * i];
+        b = &data.polygons[2 * i + 1];
+        body_init_polygon(a, vertices, 0, 0, 1.0f);
+        body_init_box(b, 1.0f, 0.6f, 0, 0, 1.0f);
+        bench_place_pair(a, b);
+        DA_FREE(&vertices);
+
+        // the circle or the box touches the inside of the container half of the time
+        Body* container = &data.containers[i];
+        body_init_circle_container_pixels(container, 200, 0, 0, 0.0f);
+        container->position = data.circles[2 * i + 1].position;
+        container->position = vec2_sub(container->position, VEC2(bench_random(1.0f, 2.0f), 0.0f));
+    }
+
+    // circles with a contact and a joint between each pair
+    for (uint32_t i = 0; i < 2 * BENCH_PAIRS; i++) {
+        DA_APPEND(&data.bodies, data.circles[i]);
+    }
+    solver_bodies_resize(&data.solver_bodies, data.bodies.count);
+    for (uint32_t i = 0; i < data.bodies.count; i++) {
+        Body* body = &data.bodies.items[i];
+        body->velocity = VEC2(bench_random(-1.0f, 1.0f), bench_random(-1.0f, 1.0f));
+        body->angular_velocity = bench_random(-1.0f, 1.0f);
+        solver_bodies_load(&data.solver_bodies, i, body);
+    }
+    for (uint32_t i = 0; i < BENCH_PAIRS; i++) {
+        Body* a = &data.bodies.items[2 * i];
+        Body* b = &data.bodies.items[2 * i + 1];
+        b->position = vec2_add(a->position, VEC2(0.9f, 0.1f));
+        Vec2 normal = vec2_normalize(vec2_sub(b->position, a->position));
+        Vec2 pa = vec2_add(a->position, vec2_mult(normal, 0.5f));
+        Vec2 pb = vec2_sub(b->position, vec2_mult(normal, 0.5f));
+        constraint_penetration_init(&data.penetrations[i], pa, pb, normal, false);
+        constraint_joint_init(&data.joints[i], a, b, (int) (2 * i), (int) (2 * i + 1), vec2_add(a->position, VEC2(0.45f, 0.0f)));
+        constraint_joint_pre_solve(&data.joints[i], a, b, &data.solver_bodies, 1.0f / 60.0f);
+    }
+
+    for (uint32_t k = 0; k < BENCH_KEYS; k++) {
+        uint32_t i = bench_next() % 4096;
+        data.keys[k] = (Pair) { .i = i, .j = i + 1 + bench_next() % 4096 };
+    }
+    ht_init(&data.table, 16, 70);
+
+    World* world = &data.world;
+    world_init(world, 9.8f);
+    world->warm_start = true;
+    Body* ground = world_new_body(world);
+    body_init_box(ground, 2.0f * BENCH_WORLD_COLUMNS, 1.0f, 0, 0.5f, 0.0f);
+    for (int i = 0; i < BENCH_WORLD_COLUMNS; i++) {
+        for (int j = 0; j < BENCH_WORLD_COLUMNS; j++) {
+            Body* box = world_new_body(world);
+            body_init_box(box, 1.0f, 1.0f, (float) j - BENCH_WORLD_COLUMNS / 2.0f, -0.5f - (float) i, 1.0f);
+        }
+    }
+    for (int step = 0; step < 60; step++) {
+        world_update(world, 1.0f / 60.0f);
+    }
+    world_snapshot(world, &data.snapshot);
+
+    // awake worlds, like the environments of a training run
+    batch_init(&data.batch, BENCH_BATCH_WORLDS, 9.8f, threadpool_num_cores());
+    for (uint32_t w = 0; w < BENCH_BATCH_WORLDS; w++) {
+        World* batch_world = &data.batch.worlds[w];
+        batch_world->warm_start = true;
+        batch_world->allow_sleep = false;
+        Body* batch_ground = world_new_body(batch_world);
+        body_init_box(batch_ground, 2.0f * BENCH_BATCH_COLUMNS, 1.0f, 0, 0.5f, 0.0f);
+        for (int i = 0; i < BENCH_BATCH_COLUMNS; i++) {
+            for (int j = 0; j < BENCH_BATCH_COLUMNS; j++) {
+                Body* box = world_new_body(batch_world);
+                body_init_box(box, 1.0f, 1.0f, (float) j - BENCH_BATCH_COLUMNS / 2.0f + 0.5f, -0.5f - (float) i, 1.0f);
+            }
+        }
+    }
+    for (int step = 0; step < 60; step++) {
+        batch_update(&data.batch, 1.0f / 60.0f);
+    }
+}
+
+static uint32_t bench_circlecircle(void) {
+    Contact contacts[2];
+    uint32_t num_contacts;
+    for (uint32_t i = 0; i < BENCH_PAIRS; i++) {
+        num_contacts = 0;
+        sink += collision_iscolliding_circlecircle(&data.circles[2 * i], &data.circles[2 * i + 1], contacts, &num_contacts);
+    }
+    return BENCH_PAIRS;
+}
+
+static uint32_t bench_polygonpolygon_box(void) {
+    Contact contacts[2];
+    uint32_t num_contacts;
+    for (uint32_t i = 0; i < BENCH_PAIRS; i++) {
+        num_contacts = 0;
+        sink += collision_iscolliding_polygonpolygon(&data.boxes[2 * i], &data.boxes[2 * i + 1], contacts, &num_contacts);
+    }
+    return BENCH_PAIRS;
+}
+
+static uint32_t bench_boxbox(void) {
+    Contact contacts[2];
+    uint32_t num_contacts;
+    for (uint32_t i = 0; i < BENCH_PAIRS; i++) {
+        num_contacts = 0;
+        sink += collision_iscolliding_boxbox(&data.boxes[2 * i], &data.boxes[2 * i + 1], contacts, &num_contacts);
+    }
+    return BENCH_PAIRS;
+}
+
+static uint32_t bench_polygonpolygon_hexagon(void) {
+    Contact contacts[2];
+    uint32_t num_contacts;
+    for (uint32_t i = 0; i < BENCH_PAIRS; i++) {
+        num_contacts = 0;
+        sink += collision_iscolliding_polygonpolygon(&data.polygons[2 * i], &data.polygons[2 * i + 1], contacts, &num_contacts);
+    }
+    return BENCH_PAIRS;
+}
+
+static uint32_t bench_polygoncircle(void) {
+    Contact contacts[2];
+    uint32_t num_contacts;
+    for (uint32_t i = 0; i < BENCH_PAIRS; i++) {
+        num_contacts = 0;
+        sink += collision_iscolliding_polygoncircle(&data.boxes[2 * i], &data.circles[2 * i + 1], contacts, &num_contacts);
+    }
+    return BENCH_PAIRS;
+}
+
+static uint32_t bench_containercircle(void) {
+    Contact contacts[2];
+    uint32_t num_contacts;
+    for (uint32_t i = 0; i < BENCH_PAIRS; i++) {
+        num_contacts = 0;
+        sink += collision_iscolliding_containercircle(&data.containers[i], &data.circles[2 * i + 1], contacts, &num_contacts);
+    }
+    return BENCH_PAIRS;
+}
+
+static uint32_t bench_containerpolygon(void) {
+    Contact contacts[2];
+    uint32_t num_contacts;
+    for (uint32_t i = 0; i < BENCH_PAIRS; i++) {
+        num_contacts = 0;
+        sink += collision_iscolliding_containerpolygon(&data.containers[i], &data.boxes[2 * i + 1], contacts, &num_contacts);
+    }
+    return BENCH_PAIRS;
+}
+
+static uint32_t bench_find_min_separation(void) {
+    int index = 0;
+    int support = 0;
+    float separation = 0.0f;
+    for (uint32_t i = 0; i < BENCH_PAIRS; i++) {
+        separation += shape_polygon_find_min_separation(
+            &data.polygons[2 * i].shape.as.polygon, &data.polygons[2 * i + 1].shape.as.polygon, &index, &support);
+    }
+    sink += (uint32_t) (index + support) + (separation > 0.0f);
+    return BENCH_PAIRS;
+}
+
+static uint32_t bench_penetration_pre_solve(void) {
+    for (uint32_t i = 0; i < BENCH_PAIRS; i++) {
+        constraint_penetration_pre_solve(&data.penetrations[i], &data.bodies.items[2 * i], &data.bodies.items[2 * i + 1],
+            &data.solver_bodies, (int) (2 * i), (int) (2 * i + 1), 1.0f / 60.0f);
+    }
+    return BENCH_PAIRS;
+}
+
+static uint32_t bench_penetration_solve(void) {
+    for (uint32_t i = 0; i < BENCH_PAIRS; i++) {
+        constraint_penetration_solve(&data.penetrations[i], &data.solver_bodies, (int) (2 * i), (int) (2 * i + 1));
+    }
+    return BENCH_PAIRS;
+}
+
+static uint32_t bench_joint_solve(void) {
+    for (uint32_t i = 0; i < BENCH_PAIRS; i++) {
+        constraint_joint_solve(&data.joints[i], &data.solver_bodies);
+    }
+    return BENCH_PAIRS;
+}
+
+// inserts all the keys in an empty table, growing it
+static uint32_t bench_ht_insert(void) {
+    ht_free(&data.table);
+    ht_init(&data.table, 16, 70);
+    bool found = false;
+    for (uint32_t k = 0; k < BENCH_KEYS; k++) {
+        ht_get_or_new(&data.table, data.keys[k], k, &found);
+    }
+    sink += data.table.count;
+    return BENCH_KEYS;
+}
+
+// all the keys are already in the table
+static uint32_t bench_ht_hit(void) {
+    bool found = false;
+    uint32_t hits = 0;
+    for (uint32_t k = 0; k < BENCH_KEYS; k++) {
+        ht_get_or_new(&data.table, data.keys[k], k, &found);
+        hits += found;
+    }
+    sink += hits;
+    return BENCH_KEYS;
+}
+
+// removes every key and puts it back, the table stays full
+static uint32_t bench_ht_churn(void) {
+    bool found = false;
+    for (uint32_t k = 0; k < BENCH_KEYS; k++) {
+        ht_remove(&data.table, data.keys[k]);
+        ht_get_or_new(&data.table, data.keys[k], k, &found);
+    }
+    sink += data.table.count;
+    return BENCH_KEYS;
+}
+
+static uint32_t bench_world_snapshot(void) {
+    world_snapshot(&data.world, &data.snapshot);
+    sink += data.snapshot.count;
+    return 1;
+}
+
+static uint32_t bench_world_restore(void) {
+    world_restore(&data.world, &data.snapshot);
+    sink += data.world.manifolds.count;
+    return 1;
+}
+
+// an operation is one step of one world
+static uint32_t bench_world_update_serial(void) {
+    for (uint32_t w = 0; w < BENCH_BATCH_WORLDS; w++) {
+        world_update(&data.batch.worlds[w], 1.0f / 60.0f);
+    }
+    sink += data.batch.worlds[0].manifolds.count;
+    return BENCH_BATCH_WORLDS;
+}
+
+static uint32_t bench_batch_update(void) {
+    batch_update(&data.batch, 1.0f / 60.0f);
+    sink += (uint32_t) data.batch.positions.count;
+    return BENCH_BATCH_WORLDS;
+}
+
+int main(void) {
+    bench_init();
+
+    bench_run("collision_iscolliding_circlecircle", bench_circlecircle);
+    bench_run("collision_iscolliding_polygonpolygon (box)", bench_polygonpolygon_box);
+    bench_run("collision_iscolliding_boxbox", bench_boxbox);
+    bench_run("collision_iscolliding_polygonpolygon (hex)", bench_polygonpolygon_hexagon);
+    bench_run("collision_iscolliding_polygoncircle", bench_polygoncircle);
+    bench_run("collision_iscolliding_containercircle", bench_containercircle);
+    bench_run("collision_iscolliding_containerpolygon", bench_containerpolygon);
+    bench_run("shape_polygon_find_min_separation", bench_find_min_separation);
+    bench_run("constraint_penetration_pre_solve", bench_penetration_pre_solve);
+    bench_run("constraint_penetration_solve", bench_penetration_solve);
+    bench_run("constraint_joint_solve", bench_joint_solve);
+    bench_run("ht_get_or_new (insert)", bench_ht_insert);
+    bench_run("ht_get_or_new (hit)", bench_ht_hit);
+    bench_run("ht_remove + ht_get_or_new (churn)", bench_ht_churn);
+    bench_run("world_snapshot (1024 boxes)", bench_world_snapshot);
+    bench_run("world_restore (1024 boxes)", bench_world_restore);
+    bench_run("world_update x256 (16 boxes, world-steps)", bench_world_update_serial);
+    bench_run("batch_update 256 (16 boxes, world-steps)", bench_batch_update);
+
+    ht_free(&data.table);
+    world_snapshot_free(&data.snapshot);
+    world_free(&data.world);
+    batch_free(&data.batch);
+    solver_bodies_free(&data.solver_bodies);
+    DA_FREE(&data.bodies);
+    return 0;
+}
@@ -31,8 +31,8 @@ void draw_fill_circle_meters(float x, float y, float radius, uint32_t color);
 void draw_circle_line_meters(float x, float y, float radius, float angle, uint32_t color);
 void draw_rect_meters(float x, float y, float width, float height, uint32_t color);
 void draw_fill_rect_meters(float x, float y, float width, float height, uint32_t color);
-void draw_polygon_meters(float x, float y, Vec2Array cur_vertices, Vec2Array prev_vertices, float alpha, uint32_t color);
-void draw_fill_polygon_meters(float x, float y, Vec2Array cur_vertices, Vec2Array prev_vertices, float alpha, uint32_t color);
+void draw_polygon_meters(float x, float y, Vec2* cur_vertices, Vec2* prev_vertices, uint32_t count, float alpha, uint32_t color);
+void draw_fill_polygon_meters(float x, float y, Vec2* cur_vertices, Vec2* prev_vertices, uint32_t count, float alpha, uint32_t color);
 
 void draw_texture(int x, int y, int width, int height, float rotation, Texture2D* texture);
 
@@ -4,6 +4,7 @@
 #include "physics/body.h"
 #include "physics/shape.h"
 #include "physics/table.h"
+#include "physics/threadpool.h"
 #include "physics/utils.h"
 #include "physics/vec2.h"
 #include "physics/world.h"
@@ -28,6 +29,8 @@
 static bool running;
 static bool paused = false;
 static bool warm_start = true;
+static bool allow_sleep = true;
+static uint32_t substeps = 0; // 0 for the baumgarte solver
 static World world;
 static Vec2 mouse_coord = {0, 0};
 static bool gui_hovering = false;
@@ -82,6 +85,7 @@ static void demo_incline_plane(void) {
     PIXELS_PER_METER = 100.0f;
     world_init(&world, 9.8f);
     world.warm_start = warm_start;
+    world.allow_sleep = allow_sleep;
     create_walls();
     float x_center = WINDOW_WIDTH / 2.0;
     float y_center = WINDOW_HEIGHT / 2.0;
@@ -89,13 +93,14 @@ static void demo_incline_plane(void) {
     body_init_box_pixels(static_box, 200, 800, x_center, y_center, 0.0);
     static_box->restitution = 0.8;
     static_box->friction = 0.2;
-    static_box->rotation = 1.4;
+    body_set_rotation(static_box, 1.4);
 }
 
 static void demo_stack(void) {
     PIXELS_PER_METER = 30.0f; 
     world_init(&world, 9.8f);
     world.warm_start = true;
+    world.allow_sleep = allow_sleep;
     create_walls();
     float x_center = pixels_to_meters((WINDOW_WIDTH - gui_width) / 2.0f);
     float ground = pixels_to_meters(WINDOW_HEIGHT - 75.0f);
@@ -115,6 +120,10 @@ static void demo_pyramid(void) {
     PIXELS_PER_METER = 20;
     world_init(&world, 20.0f);
     world.warm_start = warm_start;
+    world.allow_sleep = allow_sleep;
+    int len_base = 36;
+    int num_boxes = len_base * (len_base + 1) / 2;
+    world_reserve(&world, num_boxes + 6, 3 * num_boxes); // a box touches about 3 others
 
     // breaking ball
     Body* handle = world_new_body(&world);
@@ -128,7 +137,6 @@ static void demo_pyramid(void) {
     constraint_joint_init(joint, handle, ball, 0, 1, handle->position);
 
     create_walls();
-    int len_base = 36;
     float x_center = pixels_to_meters((WINDOW_WIDTH - gui_width) / 2.0f);
     float ground = pixels_to_meters(WINDOW_HEIGHT - 75.0f);
     float side_len = 1.0f; // 1 meter
@@ -154,6 +162,11 @@ static void demo_rotation(void) {
     PIXELS_PER_METER = 20.0f; 
     world_init(&world, 9.8f);
     world.warm_start = true;
+    world.allow_sleep = allow_sleep;
+    // lots of bodies of the same size, the hash grid works better than the tree here
+    world_set_broadphase(&world, BROADPHASE_GRID);
+    int len_base = 24;
+    world_reserve(&world, len_base * len_base + 2, 3 * len_base * len_base);
 
     // outer circle
     float x_center = (WINDOW_WIDTH - gui_width) / 2.0f;
@@ -165,7 +178,6 @@ static void demo_rotation(void) {
     // bodies
     x_center = pixels_to_meters(x_center);
     y_center = pixels_to_meters(y_center);
-    int len_base = 24;
     float side_len = 0.8f; // 1 meter
     float x_offset = side_len * 1.25f;
     float y_offset = side_len * 1.25f;
@@ -211,9 +223,12 @@ static void (*demos[9])(void) = {
 // - penetration slop
 // - restitution
 
-// TODO: broad phase
-// TODO: collision islands
-// TODO: continuous collision detection
+static void load_demo(void) {
+    demos[current_demo]();
+    // islands are solved in parallel on all the cores
+    world_set_num_threads(&world, threadpool_num_cores());
+    world_set_substeps(&world, substeps);
+}
 
 static void setup(void) {
     open_window();
@@ -222,7 +237,7 @@ static void setup(void) {
     text_demos_size = MeasureTextEx(GetFontDefault(), "Demos", font_size, 1);
     text_num_size = MeasureTextEx(GetFontDefault(), "8", font_size, 1);
 
-    demos[current_demo]();
+    load_demo();
 }
 
 static void destroy(void) {
@@ -241,12 +256,20 @@ static void input(void) {
     if (IsKeyPressed(KEY_R)) {
         paused = false;
         world_free(&world);
-        demos[current_demo]();
+        load_demo();
     }
     if (IsKeyPressed(KEY_W)) {
         warm_start = !warm_start;
         world.warm_start = warm_start;
     }
+    if (IsKeyPressed(KEY_S)) {
+        allow_sleep = !allow_sleep;
+        world.allow_sleep = allow_sleep;
+    }
+    if (IsKeyPressed(KEY_U)) {
+        substeps = substeps == 0 ? 4 : 0;
+        world_set_substeps(&world, substeps);
+    }
 
     if (!paused) {
         // mouse
@@ -316,7 +339,7 @@ static void render_gui(void) {
                 if (IsMouseButtonReleased(MOUSE_BUTTON_LEFT) && demos[i] != NULL) {
                     current_demo = i;
                     world_free(&world);
-                    demos[current_demo]();
+                    load_demo();
                 }
             } 
 
@@ -333,6 +356,8 @@ static void render(float alpha) {
         for (uint32_t i = 0; i < world.bodies.count; i++) {
             float body_alpha = alpha;
             Body* body = &world.bodies.items[i];
+            if (body->removed)
+                continue;
             if (body_is_static(body)) {
                 body_alpha = 1;
             }
@@ -350,12 +375,14 @@ static void render(float alpha) {
             if (body->shape.type == SHAPE_BOX) {
                 uint32_t color = body_is_static(body) ? COLOR_STATIC : COLOR_BOX;
                 BoxShape* box_shape = &body->shape.as.box;
-                draw_polygon_meters(render_position.x, render_position.y, box_shape->polygon.world_vertices, box_shape->polygon.prev_world_vertices, body_alpha, color);
+                draw_polygon_meters(render_position.x, render_position.y, box_shape->polygon.world_vertices, box_shape->polygon.prev_world_vertices,
+                        box_shape->polygon.count, body_alpha, color);
             }
             if (body->shape.type == SHAPE_POLYGON) {
                 uint32_t color = body_is_static(body) ? COLOR_STATIC : COLOR_BOX;
                 PolygonShape* polygon_shape = &body->shape.as.polygon;
-                draw_polygon_meters(render_position.x, render_position.y, polygon_shape->world_vertices, polygon_shape->prev_world_vertices, body_alpha, color);
+                draw_polygon_meters(render_position.x, render_position.y, polygon_shape->world_vertices, polygon_shape->prev_world_vertices,
+                        polygon_shape->count, body_alpha, color);
             }
         }
 
@@ -409,7 +436,19 @@ static void run(void) {
             if (cur_time - prev_time_fps >= 1.0f) {
                 float frame_ms = 1000.0f / frame_count;
                 printf("FPS: %d | Num objects: %d | Num manifolds: %d\n",
-                        frame_count, world.bodies.count, world.manifold_map.count);
+                        frame_count, world.bodies.count, world.manifolds.count);
+                // last step only
+                WorldStats* stats = &world.stats;
+                printf("  step %.3f ms | forces %.3f | integrate forces %.3f | collision %.3f | islands %.3f | "
+                       "joint pre-solve %.3f | manifold pre-solve %.3f | solve %.3f | integrate velocities %.3f | ccd %.3f\n",
+                        stats->time_total, stats->time_forces, stats->time_integrate_forces, stats->time_collision,
+                        stats->time_islands, stats->time_joint_pre_solve, stats->time_manifold_pre_solve,
+                        stats->time_solve, stats->time_integrate_velocities, stats->time_ccd);
+                printf("  pairs %u tested, %u colliding | contacts %u, %u warm started | manifolds expired %u | "
+                       "manifold map %u lookups, %u probes, max probe %u | bullets clamped %u\n",
+                        stats->pairs_tested, stats->pairs_colliding, stats->contacts_created, stats->warm_start_hits,
+                        stats->manifolds_expired, stats->manifold_lookups, stats->manifold_probes, stats->manifold_max_probe,
+                        stats->bullets_clamped);
                 frame_count = 0;
                 prev_time_fps = cur_time;
             }
@@ -0,0 +1,33 @@
+#include "aabb.h"
+#include <math.h>
+
+AABB aabb_union(AABB a, AABB b) {
+    return (AABB) {
+        .min = VEC2(fminf(a.min.x, b.min.x), fminf(a.min.y, b.min.y)),
+        .max = VEC2(fmaxf(a.max.x, b.max.x), fmaxf(a.max.y, b.max.y))
+    };
+}
+
+AABB aabb_fatten(AABB a, float margin) {
+    return (AABB) {
+        .min = VEC2(a.min.x - margin, a.min.y - margin),
+        .max = VEC2(a.max.x + margin, a.max.y + margin)
+    };
+}
+
+bool aabb_overlaps(AABB a, AABB b) {
+    return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+           a.min.y <= b.max.y && a.max.y >= b.min.y;
+}
+
+bool aabb_contains(AABB outer, AABB inner) {
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y &&
+           outer.max.x >= inner.max.x && outer.max.y >= inner.max.y;
+}
+
+float aabb_perimeter(AABB a) {
+    // used as the cost metric of the tree (surface area heuristic in 2d)
+    float width = a.max.x - a.min.x;
+    float height = a.max.y - a.min.y;
+    return 2.0f * (width + height);
+}
@@ -0,0 +1,19 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "vec2.h"
+#include <stdbool.h>
+
+// axis-aligned bounding box
+typedef struct {
+    Vec2 min;
+    Vec2 max;
+} AABB;
+
+AABB aabb_union(AABB a, AABB b);
+AABB aabb_fatten(AABB a, float margin);
+bool aabb_overlaps(AABB a, AABB b);
+bool aabb_contains(AABB outer, AABB inner);
+float aabb_perimeter(AABB a);
+
+#endif // AABB_H
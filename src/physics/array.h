@@ -45,6 +45,18 @@ typedef struct {
       (void) 0,                                                                         \
       &((xs)->items[(xs)->count++]))
 
+#define DA_RESERVE(xs, n)                                                                   \
+    do {                                                                                    \
+        if ((xs)->capacity < (n)) {                                                         \
+            (xs)->capacity = (n);                                                           \
+            (xs)->items = realloc((xs)->items, (xs)->capacity * sizeof(*(xs)->items));      \
+            if ((xs)->items == NULL) {                                                      \
+                printf("ERROR: out of memory, aborting.\n");                                \
+                exit(1);                                                                    \
+            }                                                                               \
+        }                                                                                   \
+    } while (0)
+
 #define DA_NULL { .capacity = 0, .count = 0, .items = NULL }
 
 // pointer must be set to NULL otherwise next realloc on this pointer will be undefined
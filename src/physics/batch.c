@@ -0,0 +1,100 @@
+#include "batch.h"
+#include "array.h"
+#include "body.h"
+#include "threadpool.h"
+#include "world.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    WorldBatch* batch;
+    float dt;
+    bool step;
+} BatchContext;
+
+void batch_init(WorldBatch* batch, uint32_t num_worlds, float gravity, uint32_t num_threads) {
+    *batch = (WorldBatch) { 0 };
+    batch->worlds = calloc(num_worlds, sizeof(World));
+    if (num_worlds > 0 && batch->worlds == NULL) {
+        printf("ERROR: can't allocate %u worlds, aborting.\n", num_worlds);
+        exit(1);
+    }
+    batch->num_worlds = num_worlds;
+    for (uint32_t i = 0; i < num_worlds; i++) {
+        world_init(&batch->worlds[i], gravity);
+    }
+    threadpool_init(&batch->thread_pool, num_threads);
+    DA_RESERVE(&batch->body_offsets, num_worlds + 1);
+}
+
+void batch_free(WorldBatch* batch) {
+    for (uint32_t i = 0; i < batch->num_worlds; i++) {
+        world_free(&batch->worlds[i]);
+    }
+    free(batch->worlds);
+    threadpool_free(&batch->thread_pool);
+    DA_FREE(&batch->body_offsets);
+    DA_FREE(&batch->positions);
+    DA_FREE(&batch->rotations);
+    DA_FREE(&batch->velocities);
+    DA_FREE(&batch->angular_velocities);
+}
+
+void batch_reserve(WorldBatch* batch, uint32_t num_bodies, uint32_t num_manifolds) {
+    for (uint32_t i = 0; i < batch->num_worlds; i++) {
+        world_reserve(&batch->worlds[i], num_bodies, num_manifolds);
+    }
+}
+
+// bodies are only added between updates, so the slots of each world are known before stepping them
+static void batch_layout(WorldBatch* batch) {
+    uint32_t num_bodies = 0;
+    batch->body_offsets.count = batch->num_worlds + 1;
+    for (uint32_t i = 0; i < batch->num_worlds; i++) {
+        batch->body_offsets.items[i] = (int) num_bodies;
+        num_bodies += batch->worlds[i].bodies.count;
+    }
+    batch->body_offsets.items[batch->num_worlds] = (int) num_bodies;
+    DA_RESERVE(&batch->positions, num_bodies);
+    DA_RESERVE(&batch->rotations, num_bodies);
+    DA_RESERVE(&batch->velocities, num_bodies);
+    DA_RESERVE(&batch->angular_velocities, num_bodies);
+    batch->positions.count = num_bodies;
+    batch->rotations.count = num_bodies;
+    batch->velocities.count = num_bodies;
+    batch->angular_velocities.count = num_bodies;
+}
+
+// the state is written by the thread that stepped the world, while its bodies are still in the cache
+static void batch_world_task(void* context, uint32_t world_index) {
+    BatchContext* ctx = context;
+    WorldBatch* batch = ctx->batch;
+    World* world = &batch->worlds[world_index];
+    if (ctx->step)
+        world_update(world, ctx->dt);
+
+    uint32_t offset = (uint32_t) batch->body_offsets.items[world_index];
+    Vec2* positions = batch->positions.items + offset;
+    float* rotations = batch->rotations.items + offset;
+    Vec2* velocities = batch->velocities.items + offset;
+    float* angular_velocities = batch->angular_velocities.items + offset;
+    for (uint32_t i = 0; i < world->bodies.count; i++) {
+        Body* body = &world->bodies.items[i];
+        positions[i] = body->position;
+        rotations[i] = body->rotation;
+        velocities[i] = body->velocity;
+        angular_velocities[i] = body->angular_velocity;
+    }
+}
+
+void batch_update(WorldBatch* batch, float dt) {
+    batch_layout(batch);
+    BatchContext context = { .batch = batch, .dt = dt, .step = true };
+    threadpool_run(&batch->thread_pool, batch->num_worlds, batch_world_task, &context);
+}
+
+void batch_observe(WorldBatch* batch) {
+    batch_layout(batch);
+    BatchContext context = { .batch = batch, .step = false };
+    threadpool_run(&batch->thread_pool, batch->num_worlds, batch_world_task, &context);
+}
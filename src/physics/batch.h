@@ -0,0 +1,36 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "array.h"
+#include "threadpool.h"
+#include "vec2.h"
+#include "world.h"
+#include <stdint.h>
+
+// many small independent worlds (e.g. the environments of a training run) stepped together: each task of the
+// thread pool steps one whole world, so the worlds themselves run on a single thread and the result doesn't
+// depend on the number of threads
+typedef struct {
+    World* worlds; // allocated once, a world doesn't move
+    uint32_t num_worlds;
+    ThreadPool thread_pool;
+    // the state of all the body slots of all the worlds, one array per value, written by batch_update and
+    // batch_observe. The slots of world i are [body_offsets.items[i], body_offsets.items[i + 1]).
+    // The arrays move when the worlds get more bodies
+    IntArray body_offsets;
+    Vec2Array positions;
+    FloatArray rotations;
+    Vec2Array velocities;
+    FloatArray angular_velocities;
+} WorldBatch;
+
+void batch_init(WorldBatch* batch, uint32_t num_worlds, float gravity, uint32_t num_threads);
+void batch_free(WorldBatch* batch);
+// presizes the bodies and the manifolds of every world, see world_reserve
+void batch_reserve(WorldBatch* batch, uint32_t num_bodies, uint32_t num_manifolds);
+// steps every world and writes the state of their bodies
+void batch_update(WorldBatch* batch, float dt);
+// writes the state of the bodies without stepping, e.g. after resetting some worlds
+void batch_observe(WorldBatch* batch);
+
+#endif // BATCH_H
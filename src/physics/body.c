@@ -13,6 +13,8 @@ void body_init_circle(Body* body, float radius, float x, float y, float mass) {
     body->velocity = VEC2(0, 0);
     body->acceleration = VEC2(0, 0);
     body->rotation = 0;
+    body->prev_rotation = 0;
+    body->rot = rotation_from_angle(0);
     body->angular_velocity = 0;
     body->angular_acceleration = 0;
     body->sum_forces = VEC2(0, 0);
@@ -22,20 +24,24 @@ void body_init_circle(Body* body, float radius, float x, float y, float mass) {
     body->restitution = 1.0f;
     body->friction = 0.7f;
     body->static_torque = 0.0f;
+    body->bullet = false;
+    body->moving = false;
+    body->sleep_time = 0.0f;
+    body->sleeping = false;
 }
 
 void body_init_polygon(Body* body, Vec2Array vertices, float x, float y, float mass) {
     shape_init_polygon(&body->shape, vertices);
     float I = shape_moment_of_inertia(&body->shape) * mass;
     body->position = VEC2(x, y);
-    shape_update_vertices(&body->shape, 0, body->position);
-    for (uint32_t i = 0; i < body->shape.as.polygon.world_vertices.count; i++) {
-        body->shape.as.polygon.prev_world_vertices.items[i] = body->shape.as.polygon.world_vertices.items[i];
-    }
+    shape_update_vertices(&body->shape, rotation_from_angle(0), body->position);
+    shape_sync_prev_vertices(&body->shape);
     body->prev_position = body->position;
     body->velocity = VEC2(0, 0);
     body->acceleration = VEC2(0, 0);
     body->rotation = 0;
+    body->prev_rotation = 0;
+    body->rot = rotation_from_angle(0);
     body->angular_velocity = 0;
     body->angular_acceleration = 0;
     body->sum_forces = VEC2(0, 0);
@@ -45,20 +51,24 @@ void body_init_polygon(Body* body, Vec2Array vertices, float x, float y, float m
     body->restitution = 1.0f;
     body->friction = 0.7f;
     body->static_torque = 0.0f;
+    body->bullet = false;
+    body->moving = false;
+    body->sleep_time = 0.0f;
+    body->sleeping = false;
 }
 
 void body_init_box(Body* body, float width, float height, float x, float y, float mass) {
     shape_init_box(&body->shape, width, height);
     float I = shape_moment_of_inertia(&body->shape) * mass;
     body->position = VEC2(x, y);
-    shape_update_vertices(&body->shape, 0, body->position);
-    for (uint32_t i = 0; i < body->shape.as.polygon.world_vertices.count; i++) {
-        body->shape.as.polygon.prev_world_vertices.items[i] = body->shape.as.polygon.world_vertices.items[i];
-    }
+    shape_update_vertices(&body->shape, rotation_from_angle(0), body->position);
+    shape_sync_prev_vertices(&body->shape);
     body->prev_position = body->position;
     body->velocity = VEC2(0, 0);
     body->acceleration = VEC2(0, 0);
     body->rotation = 0;
+    body->prev_rotation = 0;
+    body->rot = rotation_from_angle(0);
     body->angular_velocity = 0;
     body->angular_acceleration = 0;
     body->sum_forces = VEC2(0, 0);
@@ -68,6 +78,10 @@ void body_init_box(Body* body, float width, float height, float x, float y, floa
     body->restitution = 1.0f;
     body->friction = 0.7f;
     body->static_torque = 0.0f;
+    body->bullet = false;
+    body->moving = false;
+    body->sleep_time = 0.0f;
+    body->sleeping = false;
 }
 
 void body_init_circle_pixels(Body* body, int radius, int x, int y, float mass) {
@@ -78,6 +92,8 @@ void body_init_circle_pixels(Body* body, int radius, int x, int y, float mass) {
     body->velocity = VEC2(0, 0);
     body->acceleration = VEC2(0, 0);
     body->rotation = 0;
+    body->prev_rotation = 0;
+    body->rot = rotation_from_angle(0);
     body->angular_velocity = 0;
     body->angular_acceleration = 0;
     body->sum_forces = VEC2(0, 0);
@@ -87,6 +103,10 @@ void body_init_circle_pixels(Body* body, int radius, int x, int y, float mass) {
     body->restitution = 1.0f;
     body->friction = 0.7f;
     body->static_torque = 0.0f;
+    body->bullet = false;
+    body->moving = false;
+    body->sleep_time = 0.0f;
+    body->sleeping = false;
 }
 
 void body_init_circle_container_pixels(Body* body, int radius, int x, int y, float mass) {
@@ -97,6 +117,8 @@ void body_init_circle_container_pixels(Body* body, int radius, int x, int y, flo
     body->velocity = VEC2(0, 0);
     body->acceleration = VEC2(0, 0);
     body->rotation = 0;
+    body->prev_rotation = 0;
+    body->rot = rotation_from_angle(0);
     body->angular_velocity = 0;
     body->angular_acceleration = 0;
     body->sum_forces = VEC2(0, 0);
@@ -106,6 +128,10 @@ void body_init_circle_container_pixels(Body* body, int radius, int x, int y, flo
     body->restitution = 1.0f;
     body->friction = 0.7f;
     body->static_torque = 0.0f;
+    body->bullet = false;
+    body->moving = false;
+    body->sleep_time = 0.0f;
+    body->sleeping = false;
 }
 
 void body_init_polygon_pixels(Body* body, Vec2Array vertices, int x, int y, float mass) {
@@ -114,16 +140,16 @@ void body_init_polygon_pixels(Body* body, Vec2Array vertices, int x, int y, floa
         vertices.items[i] = VEC2(pixels_to_meters(v.x), pixels_to_meters(v.y));
     }
     shape_init_polygon(&body->shape, vertices);
-    for (uint32_t i = 0; i < body->shape.as.polygon.world_vertices.count; i++) {
-        body->shape.as.polygon.prev_world_vertices.items[i] = body->shape.as.polygon.world_vertices.items[i];
-    }
     float I = shape_moment_of_inertia(&body->shape) * mass;
     body->position = VEC2(pixels_to_meters(x), pixels_to_meters(y));
-    shape_update_vertices(&body->shape, 0, body->position);
+    shape_update_vertices(&body->shape, rotation_from_angle(0), body->position);
+    shape_sync_prev_vertices(&body->shape);
     body->prev_position = body->position;
     body->velocity = VEC2(0, 0);
     body->acceleration = VEC2(0, 0);
     body->rotation = 0;
+    body->prev_rotation = 0;
+    body->rot = rotation_from_angle(0);
     body->angular_velocity = 0;
     body->angular_acceleration = 0;
     body->sum_forces = VEC2(0, 0);
@@ -133,20 +159,24 @@ void body_init_polygon_pixels(Body* body, Vec2Array vertices, int x, int y, floa
     body->restitution = 1.0f;
     body->friction = 0.7f;
     body->static_torque = 0.0f;
+    body->bullet = false;
+    body->moving = false;
+    body->sleep_time = 0.0f;
+    body->sleeping = false;
 }
 
 void body_init_box_pixels(Body* body, float width, float height, int x, int y, float mass) {
     shape_init_box(&body->shape, pixels_to_meters(width), pixels_to_meters(height));
     float I = shape_moment_of_inertia(&body->shape) * mass;
     body->position = VEC2(pixels_to_meters(x), pixels_to_meters(y));
-    shape_update_vertices(&body->shape, 0, body->position);
-    for (uint32_t i = 0; i < body->shape.as.polygon.world_vertices.count; i++) {
-        body->shape.as.polygon.prev_world_vertices.items[i] = body->shape.as.polygon.world_vertices.items[i];
-    }
+    shape_update_vertices(&body->shape, rotation_from_angle(0), body->position);
+    shape_sync_prev_vertices(&body->shape);
     body->prev_position = body->position;
     body->velocity = VEC2(0, 0);
     body->acceleration = VEC2(0, 0);
     body->rotation = 0;
+    body->prev_rotation = 0;
+    body->rot = rotation_from_angle(0);
     body->angular_velocity = 0;
     body->angular_acceleration = 0;
     body->sum_forces = VEC2(0, 0);
@@ -156,14 +186,42 @@ void body_init_box_pixels(Body* body, float width, float height, int x, int y, f
     body->restitution = 1.0f;
     body->friction = 0.7f;
     body->static_torque = 0.0f;
+    body->bullet = false;
+    body->moving = false;
+    body->sleep_time = 0.0f;
+    body->sleeping = false;
 }
 
 
+// a teleport isn't interpolated, and a body that isn't moving is never transformed again
+void body_set_position(Body* body, Vec2 position) {
+    body->position = position;
+    body->prev_position = position;
+    body->prev_rotation = body->rotation;
+    shape_update_vertices(&body->shape, body->rot, body->position);
+    shape_sync_prev_vertices(&body->shape);
+    body_wake(body);
+}
+
+void body_set_rotation(Body* body, float rotation) {
+    body->rotation = rotation;
+    body->rot = rotation_from_angle(rotation);
+    body->prev_position = body->position;
+    body->prev_rotation = rotation;
+    shape_update_vertices(&body->shape, body->rot, body->position);
+    shape_sync_prev_vertices(&body->shape);
+    body_wake(body);
+}
+
 void body_add_force(Body* body, Vec2 force) {
+    if (body->sleeping)
+        body_wake(body);
     body->sum_forces = vec2_add(body->sum_forces, force);
 }
 
 void body_add_torque(Body* body, float torque) {
+    if (body->sleeping)
+        body_wake(body);
     body->sum_torque += torque;
 }
 
@@ -197,23 +255,39 @@ void body_integrate_forces(Body* body, float dt) {
     // angular
     body->angular_acceleration = body->sum_torque * body->inv_I;
     body->angular_velocity += body->angular_acceleration * dt;
-    body->angular_velocity *= 0.99f;
+    body->angular_velocity *= BODY_ANGULAR_DAMPING;
 
     body_clear_forces(body);
     body_clear_torque(body);
 }
 
 void body_integrate_velocities(Body* body, float dt) {
-    /*if (body_is_static(body))*/
-    /*    return;*/
+    body_integrate_displacement(body, vec2_scale(body->velocity, dt), body->angular_velocity * dt);
+}
 
-    // integrate velocities to find new position and rotation
+void body_integrate_displacement(Body* body, Vec2 displacement, float rotation) {
     body->prev_position = body->position;
-    body->position = vec2_add(body->position, vec2_scale(body->velocity, dt));
-    body->rotation += body->angular_velocity * dt;
+    body->prev_rotation = body->rotation;
+    bool was_moving = body->moving;
+    body->moving = displacement.x != 0.0f || displacement.y != 0.0f || rotation != 0.0f;
+    if (!body->moving) {
+        // static and resting bodies keep their vertices, they only catch up with the render interpolation once
+        if (was_moving)
+            shape_sync_prev_vertices(&body->shape);
+        return;
+    }
+
+    // integrate velocities to find new position and rotation
+    body->position = vec2_add(body->position, displacement);
+    if (rotation != 0.0f) {
+        body->rotation += rotation;
+        body->rot = rotation_from_angle(body->rotation);
+    }
+}
 
-    // update the vertices according to new position and rotation
-    shape_update_vertices(&body->shape, body->rotation, body->position);
+void body_update_vertices(Body* body) {
+    if (body->moving)
+        shape_update_vertices(&body->shape, body->rot, body->position);
 }
 
 bool body_is_static(Body* body) {
@@ -221,6 +295,40 @@ bool body_is_static(Body* body) {
     return (float) fabs(body->inv_mass - 0.0f) < epsilon;
 }
 
+bool body_is_awake(Body* body) {
+    return !body->sleeping && !body_is_static(body);
+}
+
+void body_wake(Body* body) {
+    body->sleeping = false;
+    body->sleep_time = 0.0f;
+}
+
+void body_sleep(Body* body) {
+    body->sleeping = true;
+    body->velocity = VEC2(0, 0);
+    body->angular_velocity = 0.0f;
+    body_clear_forces(body);
+    body_clear_torque(body);
+    body->moving = false;
+
+    // stop the render interpolation where the body is
+    body->prev_position = body->position;
+    body->prev_rotation = body->rotation;
+    shape_sync_prev_vertices(&body->shape);
+}
+
+void body_update_sleep_time(Body* body, float dt) {
+    float linear_tolerance = 0.01f; // 1 cm/s
+    float angular_tolerance = 0.035f; // 2 deg/s
+    bool is_moving = vec2_magnitude_squared(body->velocity) > linear_tolerance * linear_tolerance ||
+        fabsf(body->angular_velocity) > angular_tolerance;
+    if (is_moving)
+        body->sleep_time = 0.0f;
+    else
+        body->sleep_time += dt;
+}
+
 void body_apply_impulse_at_point(Body* body, Vec2 jn, Vec2 r) {
     if (body_is_static(body))
         return;
@@ -241,14 +349,42 @@ void body_apply_impulse_angular(Body *body, float j) {
 }
 
 Vec2 body_local_to_world_space(Body* body, Vec2 point) {
-    Vec2 rotated_point = vec2_rotate(point, body->rotation);
+    Vec2 rotated_point = vec2_rotate_by(point, body->rot);
     Vec2 translated_point = vec2_add(rotated_point, body->position);
     return translated_point;
 }
 
 Vec2 body_world_to_local_space(Body* body, Vec2 point) {
     Vec2 translated_point = vec2_sub(point, body->position);
-    Vec2 rotated_point = vec2_rotate(translated_point, -body->rotation);
+    Vec2 rotated_point = vec2_inv_rotate_by(translated_point, body->rot);
     return rotated_point;
 }
 
+AABB body_compute_aabb(Body* body) {
+    switch (body->shape.type) {
+        case SHAPE_CIRCLE:
+        case SHAPE_CIRCLE_CONTAINER: {
+            // the container collides with what is inside it, so its bounds are the same as a circle
+            float r = body->shape.as.circle.radius;
+            return (AABB) {
+                .min = VEC2(body->position.x - r, body->position.y - r),
+                .max = VEC2(body->position.x + r, body->position.y + r)
+            };
+        } break;
+        case SHAPE_POLYGON:
+        case SHAPE_BOX: {
+            PolygonShape* polygon = &body->shape.as.polygon;
+            AABB aabb = { .min = polygon->world_vertices[0], .max = polygon->world_vertices[0] };
+            for (uint32_t i = 1; i < polygon->count; i++) {
+                Vec2 v = polygon->world_vertices[i];
+                aabb.min.x = fminf(aabb.min.x, v.x);
+                aabb.min.y = fminf(aabb.min.y, v.y);
+                aabb.max.x = fmaxf(aabb.max.x, v.x);
+                aabb.max.y = fmaxf(aabb.max.y, v.y);
+            }
+            return aabb;
+        } break;
+    }
+    // should never reach this
+    return (AABB) { .min = body->position, .max = body->position };
+}
@@ -3,8 +3,11 @@
 
 #include "vec2.h"
 #include "shape.h"
+#include "aabb.h"
 #include <stdbool.h>
 
+#define BODY_ANGULAR_DAMPING 0.99f // the angular velocity is scaled by it every step
+
 typedef struct Body {
     Shape shape;
 
@@ -16,6 +19,8 @@ typedef struct Body {
 
     // angular motion
     float rotation;
+    float prev_rotation; // at the start of the step, like prev_position
+    Rotation rot; // cos and sin of the rotation, computed once per step
     float angular_velocity;
     float angular_acceleration;
 
@@ -31,6 +36,16 @@ typedef struct Body {
     // coefficients of restitution and friction
     float restitution;
     float friction;
+
+    // continuous collision: fast bullets are swept against static and non bullet bodies so that they don't go through them
+    bool bullet;
+    // the position or rotation changed in the last step, so the vertices need to be transformed
+    bool moving;
+    // sleeping
+    float sleep_time; // how long the body has been (almost) still
+    bool sleeping;
+    // the slot of a removed body stays in the world's array until it is reused or compacted
+    bool removed;
 } Body;
 
 typedef struct {
@@ -46,6 +61,9 @@ void body_init_circle_pixels(Body* body, int radius, int x, int y, float mass);
 void body_init_circle_container_pixels(Body* body, int radius, int x, int y, float mass);
 void body_init_polygon_pixels(Body* body, Vec2Array vertices, int x, int y, float mass);
 void body_init_box_pixels(Body* body, float width, float height, int x, int y, float mass);
+// move the vertices too and wake the body, use them instead of writing the position or rotation of a body that is in a world
+void body_set_position(Body* body, Vec2 position);
+void body_set_rotation(Body* body, float rotation);
 void body_integrate_linear(Body* body, float dt);
 void body_integrate_angular(Body* body, float dt);
 void body_add_force(Body* body, Vec2 force);
@@ -54,12 +72,21 @@ void body_add_static_torque(Body* body, float torque);
 void body_clear_forces(Body* body);
 void body_clear_torque(Body* body);
 bool body_is_static(Body* body);
+bool body_is_awake(Body* body);
+void body_wake(Body* body);
+void body_sleep(Body* body);
+void body_update_sleep_time(Body* body, float dt);
 void body_apply_impulse_at_point(Body* body, Vec2 jn, Vec2 r);
 void body_apply_impulse_linear(Body* body, Vec2 jn);
 void body_apply_impulse_angular(Body* body, float j);
 Vec2 body_local_to_world_space(Body* body, Vec2 point);
 Vec2 body_world_to_local_space(Body* body, Vec2 point);
 void body_integrate_forces(Body* body, float dt);
+// only moves the position and rotation, the vertices are transformed afterwards with body_update_vertices
 void body_integrate_velocities(Body* body, float dt);
+// same, with the displacement and rotation of the step given by the substep solver
+void body_integrate_displacement(Body* body, Vec2 displacement, float rotation);
+void body_update_vertices(Body* body);
+AABB body_compute_aabb(Body* body);
 
 #endif //  BODY_H
@@ -0,0 +1,113 @@
+#include "broadphase.h"
+#include "array.h"
+#include "body.h"
+#include "grid.h"
+#include "tree.h"
+
+typedef struct {
+    BroadPhase* broadphase;
+    BodyArray bodies;
+    int query_index;
+} QueryContext;
+
+static bool broadphase_query_callback(void* context, int user_data) {
+    QueryContext* ctx = context;
+    int i = ctx->query_index;
+    int j = user_data;
+    if (i == j)
+        return true;
+
+    // static bodies never query the tree, so their pairs are only found from the other side.
+    // Pairs between two non static bodies are found twice, keep only one of them
+    Body* other = &ctx->bodies.items[j];
+    if (!body_is_static(other) && j < i)
+        return true;
+
+    Pair pair = i < j ? (Pair){i, j} : (Pair){j, i};
+    DA_APPEND(&ctx->broadphase->pairs, pair);
+    return true;
+}
+
+void broadphase_init(BroadPhase* broadphase) {
+    broadphase->type = BROADPHASE_TREE;
+    tree_init(&broadphase->tree);
+    grid_init(&broadphase->grid);
+    broadphase->proxies = (IntArray) DA_NULL;
+    broadphase->pairs = (PairArray) DA_NULL;
+}
+
+void broadphase_free(BroadPhase* broadphase) {
+    tree_free(&broadphase->tree);
+    grid_free(&broadphase->grid);
+    DA_FREE(&broadphase->proxies);
+    DA_FREE(&broadphase->pairs);
+}
+
+void broadphase_update(BroadPhase* broadphase, BodyArray bodies, float dt) {
+    broadphase->pairs.count = 0;
+    if (broadphase->type == BROADPHASE_GRID) {
+        // the grid is rebuilt from scratch every step, so the tree proxies are left untouched
+        grid_update(&broadphase->grid, bodies, &broadphase->pairs);
+        return;
+    }
+
+    // refit the proxies of the bodies that moved out of their fat aabb
+    for (uint32_t i = 0; i < broadphase->proxies.count; i++) {
+        Body* body = &bodies.items[i];
+        int* proxy = &broadphase->proxies.items[i];
+        if (body->removed) {
+            if (*proxy != TREE_NULL_NODE)
+                tree_remove(&broadphase->tree, *proxy);
+            *proxy = TREE_NULL_NODE;
+        } else if (*proxy == TREE_NULL_NODE) {
+            // the slot of a removed body has been reused
+            *proxy = tree_insert(&broadphase->tree, body_compute_aabb(body), i);
+        } else {
+            Vec2 displacement = vec2_mult(body->velocity, dt);
+            tree_move(&broadphase->tree, *proxy, body_compute_aabb(body), displacement);
+        }
+    }
+
+    // create proxies for bodies that were added since the last update
+    for (uint32_t i = broadphase->proxies.count; i < bodies.count; i++) {
+        Body* body = &bodies.items[i];
+        int proxy = body->removed ? TREE_NULL_NODE : tree_insert(&broadphase->tree, body_compute_aabb(body), i);
+        DA_APPEND(&broadphase->proxies, proxy);
+    }
+
+    // find the overlapping pairs. Two static bodies never generate an impulse, so only
+    // the non static bodies query the tree
+    QueryContext ctx = { .broadphase = broadphase, .bodies = bodies };
+    for (uint32_t i = 0; i < bodies.count; i++) {
+        if (body_is_static(&bodies.items[i]) || bodies.items[i].removed)
+            continue;
+        ctx.query_index = i;
+        AABB fat_aabb = tree_get_fat_aabb(&broadphase->tree, broadphase->proxies.items[i]);
+        tree_query(&broadphase->tree, fat_aabb, broadphase_query_callback, &ctx);
+    }
+}
+
+void broadphase_query(BroadPhase* broadphase, BodyArray bodies, AABB aabb, TreeQueryCallback callback, void* context) {
+    if (broadphase->type == BROADPHASE_TREE) {
+        tree_query(&broadphase->tree, aabb, callback, context);
+        return;
+    }
+    grid_query(&broadphase->grid, bodies, aabb, callback, context);
+}
+
+void broadphase_remap(BroadPhase* broadphase, IntArray remap) {
+    // the order of the bodies is kept, so each proxy moves down to the new index of its body
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < broadphase->proxies.count; i++) {
+        int proxy = broadphase->proxies.items[i];
+        if (remap.items[i] < 0) {
+            if (proxy != TREE_NULL_NODE)
+                tree_remove(&broadphase->tree, proxy);
+            continue;
+        }
+        if (proxy != TREE_NULL_NODE)
+            tree_set_user_data(&broadphase->tree, proxy, remap.items[i]);
+        broadphase->proxies.items[count++] = proxy;
+    }
+    broadphase->proxies.count = count;
+}
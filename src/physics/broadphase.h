@@ -0,0 +1,33 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include "array.h"
+#include "body.h"
+#include "grid.h"
+#include "table.h"
+#include "tree.h"
+
+typedef enum {
+    BROADPHASE_TREE, // dynamic aabb tree, good for scenes with bodies of very different sizes
+    BROADPHASE_GRID // uniform hash grid, good for dense scenes with bodies of similar size
+} BroadPhaseType;
+
+typedef struct {
+    BroadPhaseType type;
+    DynamicTree tree;
+    SpatialGrid grid;
+    IntArray proxies; // tree proxy of each body, indexed like the world's bodies array, null for removed bodies
+    PairArray pairs; // candidate pairs (i < j) whose fat aabbs overlap, refreshed every update
+} BroadPhase;
+
+void broadphase_init(BroadPhase* broadphase);
+void broadphase_free(BroadPhase* broadphase);
+// sync the proxies with the bodies and collect the pairs that need a narrow phase check
+void broadphase_update(BroadPhase* broadphase, BodyArray bodies, float dt);
+// calls back with the index of the bodies whose aabb overlaps the given one, until the callback returns false.
+// The tree uses the fat aabbs of the last update, the grid its bins of the last update
+void broadphase_query(BroadPhase* broadphase, BodyArray bodies, AABB aabb, TreeQueryCallback callback, void* context);
+// the bodies have been compacted, remap has the new index of each old one or -1 if it was removed
+void broadphase_remap(BroadPhase* broadphase, IntArray remap);
+
+#endif // BROADPHASE_H
@@ -0,0 +1,243 @@
+#include "ccd.h"
+#include "aabb.h"
+#include "array.h"
+#include "body.h"
+#include "shape.h"
+#include "vec2.h"
+#include <float.h>
+#include <math.h>
+
+#define CCD_MAX_ITERATIONS 30
+#define CCD_TOLERANCE (0.25f * CCD_LINEAR_SLOP)
+
+static bool ccd_is_polygon(Body* body) {
+    return body->shape.type == SHAPE_POLYGON || body->shape.type == SHAPE_BOX;
+}
+
+// distance from the body's position to the farthest point of its shape
+static float ccd_max_radius(Body* body) {
+    if (!ccd_is_polygon(body))
+        return body->shape.as.circle.radius;
+    PolygonShape* polygon = &body->shape.as.polygon;
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < polygon->count; i++) {
+        radius = fmaxf(radius, vec2_magnitude(polygon->local_vertices[i]));
+    }
+    return radius;
+}
+
+// distance from the body's position to the closest edge of its shape
+static float ccd_min_extent(Body* body) {
+    if (!ccd_is_polygon(body))
+        return body->shape.as.circle.radius;
+    PolygonShape* polygon = &body->shape.as.polygon;
+    float extent = FLT_MAX;
+    for (uint32_t i = 0; i < polygon->count; i++) {
+        Vec2 va = polygon->local_vertices[i];
+        Vec2 edge = vec2_sub(polygon->local_vertices[(i + 1) % polygon->count], va);
+        extent = fminf(extent, fabsf(vec2_cross(edge, va)) / vec2_magnitude(edge));
+    }
+    return extent;
+}
+
+static Vec2 ccd_position(Sweep* sweep, float t) {
+    return vec2_add(sweep->start_position, vec2_mult(vec2_sub(sweep->end_position, sweep->start_position), t));
+}
+
+static float ccd_rotation(Sweep* sweep, float t) {
+    return sweep->start_rotation + (sweep->end_rotation - sweep->start_rotation) * t;
+}
+
+static void ccd_transform(Body* body, Vec2 position, float rotation, Vec2* vertices) {
+    PolygonShape* polygon = &body->shape.as.polygon;
+    Rotation rot = rotation_from_angle(rotation);
+    for (uint32_t i = 0; i < polygon->count; i++) {
+        vertices[i] = vec2_add(vec2_rotate_by(polygon->local_vertices[i], rot), position);
+    }
+}
+
+static Vec2 ccd_closest_point_on_segment(Vec2 p, Vec2 a, Vec2 b) {
+    Vec2 ab = vec2_sub(b, a);
+    float t = vec2_dot(vec2_sub(p, a), ab) / vec2_dot(ab, ab);
+    t = fminf(fmaxf(t, 0.0f), 1.0f);
+    return vec2_add(a, vec2_mult(ab, t));
+}
+
+// 0 if the point is inside the polygon, otherwise closest is set to the closest point of the polygon
+static float ccd_point_polygon_distance(Vec2 p, Vec2* vertices, uint32_t count, Vec2* closest) {
+    bool inside = true;
+    float distance = FLT_MAX;
+    for (uint32_t i = 0; i < count; i++) {
+        Vec2 va = vertices[i];
+        Vec2 vb = vertices[(i + 1) % count];
+        if (vec2_dot(vec2_sub(p, va), vec2_normal(vec2_sub(vb, va))) > 0)
+            inside = false;
+        Vec2 q = ccd_closest_point_on_segment(p, va, vb);
+        float d = vec2_magnitude(vec2_sub(p, q));
+        if (d < distance) {
+            distance = d;
+            *closest = q;
+        }
+    }
+    return inside ? 0.0f : distance;
+}
+
+// same as shape_polygon_find_min_separation
+static float ccd_polygon_separation(Vec2* a, uint32_t a_count, Vec2* b, uint32_t b_count) {
+    float separation = -FLT_MAX;
+    for (uint32_t i = 0; i < a_count; i++) {
+        Vec2 va = a[i];
+        Vec2 normal = vec2_normal(vec2_sub(a[(i + 1) % a_count], va));
+        float min_separation = FLT_MAX;
+        for (uint32_t j = 0; j < b_count; j++) {
+            min_separation = fminf(min_separation, vec2_dot(vec2_sub(b[j], va), normal));
+        }
+        separation = fmaxf(separation, min_separation);
+    }
+    return separation;
+}
+
+// 0 if the polygons overlap, otherwise the closest points are a vertex of one and an edge of the other.
+// The normal goes from a to b
+static float ccd_polygon_polygon_distance(Vec2* a, uint32_t a_count, Vec2* b, uint32_t b_count, Vec2* normal) {
+    if (ccd_polygon_separation(a, a_count, b, b_count) <= 0 && ccd_polygon_separation(b, b_count, a, a_count) <= 0)
+        return 0.0f;
+    float distance = FLT_MAX;
+    for (uint32_t i = 0; i < a_count; i++) {
+        for (uint32_t j = 0; j < b_count; j++) {
+            Vec2 a_to_b = vec2_sub(ccd_closest_point_on_segment(a[i], b[j], b[(j + 1) % b_count]), a[i]);
+            float d = vec2_magnitude(a_to_b);
+            if (d < distance) {
+                distance = d;
+                *normal = a_to_b;
+            }
+            a_to_b = vec2_sub(b[j], ccd_closest_point_on_segment(b[j], a[i], a[(i + 1) % a_count]));
+            d = vec2_magnitude(a_to_b);
+            if (d < distance) {
+                distance = d;
+                *normal = a_to_b;
+            }
+        }
+    }
+    *normal = vec2_normalize(*normal);
+    return distance;
+}
+
+// distance between the body at a point of its sweep and the target, negative or 0 when they overlap.
+// The normal goes from the closest point of the body to the closest point of the target
+static float ccd_distance(Body* body, Sweep* sweep, float t, Body* target, Vec2* normal) {
+    Vec2 position = ccd_position(sweep, t);
+    PolygonShape* target_polygon = &target->shape.as.polygon;
+    Vec2 closest = VEC2(0, 0);
+    float distance;
+    if (!ccd_is_polygon(body)) {
+        float radius = body->shape.as.circle.radius;
+        if (!ccd_is_polygon(target)) {
+            closest = target->position;
+            distance = vec2_magnitude(vec2_sub(target->position, position)) - radius - target->shape.as.circle.radius;
+        } else {
+            distance = ccd_point_polygon_distance(position, target_polygon->world_vertices, target_polygon->count, &closest) - radius;
+        }
+        *normal = vec2_normalize(vec2_sub(closest, position));
+        return distance;
+    }
+
+    Vec2 vertices[SHAPE_MAX_VERTICES];
+    uint32_t count = body->shape.as.polygon.count;
+    ccd_transform(body, position, ccd_rotation(sweep, t), vertices);
+    if (!ccd_is_polygon(target)) {
+        distance = ccd_point_polygon_distance(target->position, vertices, count, &closest) - target->shape.as.circle.radius;
+        *normal = vec2_normalize(vec2_sub(target->position, closest));
+        return distance;
+    }
+    return ccd_polygon_polygon_distance(vertices, count, target_polygon->world_vertices, target_polygon->count, normal);
+}
+
+// a moving circle against a circle is a ray against a circle whose radius is the sum of the two
+static float ccd_time_of_impact_circles(Body* body, Sweep* sweep, Body* target) {
+    float radius = body->shape.as.circle.radius + target->shape.as.circle.radius;
+    Vec2 m = vec2_sub(sweep->start_position, target->position);
+    Vec2 d = vec2_sub(sweep->end_position, sweep->start_position);
+    if (vec2_magnitude(m) - radius <= CCD_LINEAR_SLOP)
+        return 1.0f;
+
+    float target_radius = radius - CCD_LINEAR_SLOP;
+    float a = vec2_dot(d, d);
+    float b = vec2_dot(m, d);
+    float c = vec2_dot(m, m) - target_radius * target_radius;
+    if (b >= 0.0f || a == 0.0f)
+        return 1.0f; // moving away
+    float discriminant = b * b - a * c;
+    if (discriminant < 0.0f)
+        return 1.0f;
+    float t = (-b - sqrtf(discriminant)) / a;
+    return fminf(t, 1.0f);
+}
+
+Sweep ccd_sweep(Body* body) {
+    return (Sweep) {
+        .start_position = body->prev_position,
+        .start_rotation = body->prev_rotation,
+        .end_position = body->position,
+        .end_rotation = body->rotation
+    };
+}
+
+bool ccd_is_fast(Body* body, Sweep* sweep) {
+    float rotation = ccd_is_polygon(body) ? fabsf(sweep->end_rotation - sweep->start_rotation) * ccd_max_radius(body) : 0.0f;
+    float motion = vec2_magnitude(vec2_sub(sweep->end_position, sweep->start_position)) + rotation;
+    return motion > ccd_min_extent(body);
+}
+
+AABB ccd_sweep_aabb(Body* body, Sweep* sweep) {
+    Vec2 extent = VEC2(ccd_max_radius(body), ccd_max_radius(body));
+    AABB start = { vec2_sub(sweep->start_position, extent), vec2_add(sweep->start_position, extent) };
+    AABB end = { vec2_sub(sweep->end_position, extent), vec2_add(sweep->end_position, extent) };
+    return aabb_union(start, end);
+}
+
+// conservative advancement: the distance can't shrink faster than the motion of the body along the
+// normal between the closest points plus the speed of its farthest point because of the rotation, so it is
+// always safe to advance by distance / that bound. Without rotation, moving away means there is no hit
+float ccd_time_of_impact(Body* body, Sweep* sweep, Body* target) {
+    if (!ccd_is_polygon(body) && !ccd_is_polygon(target))
+        return ccd_time_of_impact_circles(body, sweep, target);
+
+    Vec2 translation = vec2_sub(sweep->end_position, sweep->start_position);
+    float rotation = ccd_is_polygon(body) ? fabsf(sweep->end_rotation - sweep->start_rotation) * ccd_max_radius(body) : 0.0f;
+
+    float t = 0.0f;
+    Vec2 normal;
+    float distance = ccd_distance(body, sweep, t, target, &normal);
+    if (distance <= CCD_LINEAR_SLOP)
+        return 1.0f;
+    float approach = vec2_dot(translation, normal) + rotation;
+    for (int i = 0; i < CCD_MAX_ITERATIONS && distance > CCD_TOLERANCE; i++) {
+        if (approach <= 0.0f)
+            return 1.0f;
+        t += distance / approach;
+        if (t >= 1.0f)
+            return 1.0f;
+        distance = ccd_distance(body, sweep, t, target, &normal);
+        approach = vec2_dot(translation, normal) + rotation;
+    }
+
+    // go a bit further so that the bodies overlap by the slop
+    if (approach <= 0.0f)
+        return t;
+    return fminf(t + (fmaxf(distance, 0.0f) + CCD_LINEAR_SLOP) / approach, 1.0f);
+}
+
+void ccd_move_to(Body* body, Sweep* sweep, float t) {
+    body->position = ccd_position(sweep, t);
+    body->rotation = ccd_rotation(sweep, t);
+    body->rot = rotation_from_angle(body->rotation);
+    if (!ccd_is_polygon(body))
+        return;
+    // the previous vertices are kept so that the render interpolation starts where the step did
+    PolygonShape* polygon = &body->shape.as.polygon;
+    for (uint32_t i = 0; i < polygon->count; i++) {
+        polygon->world_vertices[i] = vec2_add(vec2_rotate_by(polygon->local_vertices[i], body->rot), body->position);
+        polygon->world_normals[i] = vec2_rotate_by(polygon->local_normals[i], body->rot);
+    }
+}
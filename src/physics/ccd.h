@@ -0,0 +1,32 @@
+#ifndef CCD_H
+#define CCD_H
+
+#include "aabb.h"
+#include "array.h"
+#include "body.h"
+#include "vec2.h"
+#include <stdbool.h>
+
+// penetration left at the time of impact, so that the next narrow phase finds the contact
+#define CCD_LINEAR_SLOP 0.005f
+
+// motion of a body during the last step
+typedef struct {
+    Vec2 start_position;
+    float start_rotation;
+    Vec2 end_position;
+    float end_rotation;
+} Sweep;
+
+// sweep of a body from the start of the step to where its velocities took it
+Sweep ccd_sweep(Body* body);
+// true if the body moved enough to go through another body without the narrow phase noticing
+bool ccd_is_fast(Body* body, Sweep* sweep);
+AABB ccd_sweep_aabb(Body* body, Sweep* sweep);
+// fraction of the sweep at which the body hits the target, that doesn't move. 1 if there is no hit,
+// and also if they are already touching at the start since the narrow phase takes care of that
+float ccd_time_of_impact(Body* body, Sweep* sweep, Body* target);
+// moves the body back along its sweep, the previous vertices are kept for the render interpolation
+void ccd_move_to(Body* body, Sweep* sweep, float t);
+
+#endif // CCD_H
@@ -2,8 +2,11 @@
 #include "shape.h"
 #include "vec2.h"
 #include <float.h>
+#include <math.h>
 #include <string.h>
 
+#define COLLISION_REFERENCE_TOLERANCE 0.0005f // a tenth of the penetration slop
+
 static void swap_contacts(Contact* contacts) {
     Vec2 temp = contacts->start;
     contacts->start = contacts->end;
@@ -45,6 +48,9 @@ bool collision_iscolliding(Body* a, Body* b, Contact* contacts, uint32_t* num_co
         }
         return colliding;
     }
+    if (a->shape.type == SHAPE_BOX && b->shape.type == SHAPE_BOX) {
+        return collision_iscolliding_boxbox(a, b, contacts, num_contacts);
+    }
     if (a_is_polygon && b_is_polygon) {
         return collision_iscolliding_polygonpolygon(a, b, contacts, num_contacts);
     }
@@ -110,84 +116,174 @@ bool collision_iscolliding_containercircle(Body* container, Body* circle, Contac
     return true;
 }
 
+// the clipped points of the incident edge that are behind the reference edge are the contacts
+static void collision_add_clipped_contacts(PolygonShape* reference_shape, uint32_t index_reference_edge, Vec2* clipped_points,
+        bool a_is_reference, Contact* contacts, uint32_t* num_contacts) {
+    Vec2 reference_normal = reference_shape->world_normals[index_reference_edge];
+    Vec2 v_ref = reference_shape->world_vertices[index_reference_edge];
+    // consider only clipped points whose separation is negative (objects are penetrating)
+    for (int i = 0; i < 2; i++) {
+        Vec2 v_clip = clipped_points[i];
+        float separation = vec2_dot(vec2_sub(v_clip, v_ref), reference_normal);
+        if (separation <= 0) {
+            Contact* contact = &contacts[(*num_contacts)++];
+            contact->normal = reference_normal;
+            contact->start = v_clip;
+            contact->end = vec2_add(v_clip, vec2_mult(reference_normal, -separation));
+            if (!a_is_reference) {
+                // start, end and normal always from A to B
+                // swap start and end
+                Vec2 temp = contact->start;
+                contact->start = contact->end;
+                contact->end = temp;
+                
+                contact->normal = vec2_mult(contact->normal, -1);
+            }
+        }
+    }
+}
+
 bool collision_iscolliding_polygonpolygon(Body* a, Body* b, Contact* contacts, uint32_t* num_contacts) {
     PolygonShape* a_shape = &a->shape.as.polygon;
     PolygonShape* b_shape = &b->shape.as.polygon;
     int a_index_reference_edge, b_index_reference_edge;
-    float ab_separation = shape_polygon_find_min_separation(a_shape, b_shape, &a_index_reference_edge);
+    int b_index_support_vertex, a_index_support_vertex;
+    float ab_separation = shape_polygon_find_min_separation(a_shape, b_shape, &a_index_reference_edge, &b_index_support_vertex);
     if (ab_separation >= 0)
         return false;
-    float ba_separation = shape_polygon_find_min_separation(b_shape, a_shape, &b_index_reference_edge);
+    float ba_separation = shape_polygon_find_min_separation(b_shape, a_shape, &b_index_reference_edge, &a_index_support_vertex);
     if (ba_separation >= 0)
         return false;
 
     PolygonShape* reference_shape;
     PolygonShape* incident_shape;
     uint32_t index_reference_edge;
+    int index_support_vertex;
 
-    if (ab_separation > ba_separation) {
+    // resting faces have almost the same separation both ways, the tolerance keeps rounding from
+    // swapping the reference face from one step to the next
+    bool a_is_reference = ab_separation > ba_separation + COLLISION_REFERENCE_TOLERANCE;
+    if (a_is_reference) {
         reference_shape = a_shape;
         incident_shape = b_shape;
         index_reference_edge = a_index_reference_edge;
+        index_support_vertex = b_index_support_vertex;
     } else {
         reference_shape = b_shape;
         incident_shape = a_shape;
         index_reference_edge = b_index_reference_edge;
+        index_support_vertex = a_index_support_vertex;
     }
 
-    // find reference edge based on index returned from the function
-    Vec2 reference_edge = shape_polygon_edge_at(reference_shape, index_reference_edge);
-
     // clipping
-    int incident_index = shape_polygon_find_incident_edge_index(incident_shape, vec2_normal(reference_edge));
-    int incident_next_index = (incident_index + 1) % incident_shape->world_vertices.count;
-    Vec2 v0 = incident_shape->world_vertices.items[incident_index];
-    Vec2 v1 = incident_shape->world_vertices.items[incident_next_index];
+    Vec2 reference_normal = reference_shape->world_normals[index_reference_edge];
+    int incident_index = shape_polygon_find_incident_edge_index(incident_shape, reference_normal, index_support_vertex);
+    int incident_next_index = (incident_index + 1) % incident_shape->count;
+    Vec2 v0 = incident_shape->world_vertices[incident_index];
+    Vec2 v1 = incident_shape->world_vertices[incident_next_index];
 
     Vec2 contact_points[2] = { v0, v1 };
     Vec2 clipped_points[2] = { v0, v1 };
-    for (uint32_t i = 0; i < reference_shape->world_vertices.count; i++) {
+    for (uint32_t i = 0; i < reference_shape->count; i++) {
         if (i == index_reference_edge)
             continue;
-        Vec2 c0 = reference_shape->world_vertices.items[i];
-        Vec2 c1 = reference_shape->world_vertices.items[(i + 1) % reference_shape->world_vertices.count];
-        int num_clipped = shape_polygon_clip_segment_to_line(contact_points, clipped_points, c0, c1);
+        Vec2 c0 = reference_shape->world_vertices[i];
+        int num_clipped = shape_polygon_clip_segment_to_line(contact_points, clipped_points, c0, reference_shape->world_normals[i]);
         if (num_clipped < 2)
             break;
         // make the next contact points the ones that were just clipped
         memcpy(contact_points, clipped_points, sizeof(contact_points)); 
     }
 
-    Vec2 v_ref = reference_shape->world_vertices.items[index_reference_edge];
-    // consider only clipped points whose separation is negative (objects are penetrating)
-    for (int i = 0; i < 2; i++) {
-        Vec2 v_clip = clipped_points[i];
-        Vec2 ref_normal = vec2_normal(reference_edge);
-        float separation = vec2_dot(vec2_sub(v_clip, v_ref), ref_normal);
-        if (separation <= 0) {
-            Contact* contact = &contacts[(*num_contacts)++];
-            contact->normal = ref_normal;
-            contact->start = v_clip;
-            contact->end = vec2_add(v_clip, vec2_mult(ref_normal, -separation));
-            if (ba_separation >= ab_separation) {
-                // start, end and normal always from A to B
-                // swap start and end
-                Vec2 temp = contact->start;
-                contact->start = contact->end;
-                contact->end = temp;
-                
-                contact->normal = vec2_mult(contact->normal, -1);
-            }
-        }
+    collision_add_clipped_contacts(reference_shape, index_reference_edge, clipped_points, a_is_reference, contacts, num_contacts);
+    return true;
+}
+
+// the separation of b from the faces of a, where only the two axes of a are tested: the distance between the
+// centers along an axis picks which of its two faces looks at b, and b's extent along it comes from its half sizes
+static float collision_box_find_min_separation(Body* a, Body* b, int* index_reference_edge) {
+    PolygonShape* a_shape = &a->shape.as.box.polygon;
+    PolygonShape* b_shape = &b->shape.as.box.polygon;
+    Vec2 a_half_size = VEC2(a->shape.as.box.width * 0.5f, a->shape.as.box.height * 0.5f);
+    Vec2 b_half_size = VEC2(b->shape.as.box.width * 0.5f, b->shape.as.box.height * 0.5f);
+    // edge 1 has normal +x and edge 3 -x, edge 2 has +y and edge 0 -y
+    Vec2 b_axis_x = b_shape->world_normals[1];
+    Vec2 b_axis_y = b_shape->world_normals[2];
+    Vec2 distance = vec2_sub(b->position, a->position);
+
+    Vec2 normal = a_shape->world_normals[1];
+    float b_extent = b_half_size.x * fabsf(vec2_dot(b_axis_x, normal)) + b_half_size.y * fabsf(vec2_dot(b_axis_y, normal));
+    float projection = vec2_dot(distance, normal);
+    float separation = fabsf(projection) - a_half_size.x - b_extent;
+    *index_reference_edge = projection >= 0 ? 1 : 3;
+    if (separation > 0)
+        return separation;
+
+    normal = a_shape->world_normals[2];
+    b_extent = b_half_size.x * fabsf(vec2_dot(b_axis_x, normal)) + b_half_size.y * fabsf(vec2_dot(b_axis_y, normal));
+    projection = vec2_dot(distance, normal);
+    float y_separation = fabsf(projection) - a_half_size.y - b_extent;
+    if (y_separation > separation) {
+        separation = y_separation;
+        *index_reference_edge = projection >= 0 ? 2 : 0;
+    }
+    return separation;
+}
+
+// the edge of the box whose normal is the most opposite to the given one
+static int collision_box_find_incident_edge_index(PolygonShape* incident_shape, Vec2 normal) {
+    float x_projection = vec2_dot(incident_shape->world_normals[1], normal);
+    float y_projection = vec2_dot(incident_shape->world_normals[2], normal);
+    if (fabsf(x_projection) > fabsf(y_projection))
+        return x_projection > 0 ? 3 : 1;
+    return y_projection > 0 ? 0 : 2;
+}
+
+// same as collision_iscolliding_polygonpolygon, but the axes and the incident edge come from the box orientation
+// and the incident edge is clipped only against the two sides of the reference edge
+bool collision_iscolliding_boxbox(Body* a, Body* b, Contact* contacts, uint32_t* num_contacts) {
+    int a_index_reference_edge, b_index_reference_edge;
+    float ab_separation = collision_box_find_min_separation(a, b, &a_index_reference_edge);
+    if (ab_separation >= 0)
+        return false;
+    float ba_separation = collision_box_find_min_separation(b, a, &b_index_reference_edge);
+    if (ba_separation >= 0)
+        return false;
+
+    bool a_is_reference = ab_separation > ba_separation + COLLISION_REFERENCE_TOLERANCE;
+    PolygonShape* reference_shape = a_is_reference ? &a->shape.as.box.polygon : &b->shape.as.box.polygon;
+    PolygonShape* incident_shape = a_is_reference ? &b->shape.as.box.polygon : &a->shape.as.box.polygon;
+    uint32_t index_reference_edge = (uint32_t) (a_is_reference ? a_index_reference_edge : b_index_reference_edge);
+
+    // clipping
+    int incident_index = collision_box_find_incident_edge_index(incident_shape, reference_shape->world_normals[index_reference_edge]);
+    Vec2 v0 = incident_shape->world_vertices[incident_index];
+    Vec2 v1 = incident_shape->world_vertices[(incident_index + 1) % 4];
+
+    Vec2 contact_points[2] = { v0, v1 };
+    Vec2 clipped_points[2] = { v0, v1 };
+    // in the same order as the polygon clipping, so that the contacts come out in the same order
+    uint32_t side_edges[2] = { (index_reference_edge + 1) % 4, (index_reference_edge + 3) % 4 };
+    if (side_edges[0] > side_edges[1]) {
+        side_edges[0] = side_edges[1];
+        side_edges[1] = (index_reference_edge + 1) % 4;
+    }
+    int num_clipped = shape_polygon_clip_segment_to_line(contact_points, clipped_points,
+            reference_shape->world_vertices[side_edges[0]], reference_shape->world_normals[side_edges[0]]);
+    if (num_clipped == 2) {
+        memcpy(contact_points, clipped_points, sizeof(contact_points));
+        shape_polygon_clip_segment_to_line(contact_points, clipped_points,
+                reference_shape->world_vertices[side_edges[1]], reference_shape->world_normals[side_edges[1]]);
     }
 
+    collision_add_clipped_contacts(reference_shape, index_reference_edge, clipped_points, a_is_reference, contacts, num_contacts);
     return true;
 }
 
 bool collision_iscolliding_polygoncircle(Body* polygon, Body* circle, Contact* contacts, uint32_t* num_contacts) {
     // compute the nearest edge
     PolygonShape* polygon_shape = &polygon->shape.as.polygon;
-    Vec2Array polygon_vertices = polygon_shape->world_vertices;
+    Vec2* polygon_vertices = polygon_shape->world_vertices;
     *num_contacts = 1;
 
     bool inside = true;
@@ -195,10 +291,9 @@ bool collision_iscolliding_polygoncircle(Body* polygon, Body* circle, Contact* c
     Vec2 min_next_vertex;
     Vec2 min_normal;
     float distance_circle_edge = -FLT_MAX;
-    for (uint32_t i = 0; i < polygon_vertices.count; i++) {
-        Vec2 va = polygon_vertices.items[i];
-        Vec2 edge = shape_polygon_edge_at(polygon_shape, i);
-        Vec2 normal = vec2_normal(edge);
+    for (uint32_t i = 0; i < polygon_shape->count; i++) {
+        Vec2 va = polygon_vertices[i];
+        Vec2 normal = polygon_shape->world_normals[i];
         Vec2 va_vc = vec2_sub(circle->position, va);
         float proj = vec2_dot(va_vc, normal);
 
@@ -206,15 +301,15 @@ bool collision_iscolliding_polygoncircle(Body* polygon, Body* circle, Contact* c
         if (proj > 0 && proj > distance_circle_edge) {
             inside = false;
             distance_circle_edge = proj;
-            min_cur_vertex = polygon_vertices.items[i];
-            min_next_vertex = polygon_vertices.items[(i + 1) % polygon_vertices.count];
+            min_cur_vertex = polygon_vertices[i];
+            min_next_vertex = polygon_vertices[(i + 1) % polygon_shape->count];
             min_normal = normal;
         } else {
             // circle center is inside, find least negative projection (closest polygon edge)
             if (proj > distance_circle_edge) {
                 distance_circle_edge = proj;
-                min_cur_vertex = polygon_vertices.items[i];
-                min_next_vertex = polygon_vertices.items[(i + 1) % polygon_vertices.count];
+                min_cur_vertex = polygon_vertices[i];
+                min_next_vertex = polygon_vertices[(i + 1) % polygon_shape->count];
                 min_normal = normal;
             }
         }
@@ -226,7 +321,7 @@ bool collision_iscolliding_polygoncircle(Body* polygon, Body* circle, Contact* c
     if (!inside) {
         // check if circle center is in region A
         Vec2 ac = vec2_sub(circle->position, min_cur_vertex);
-        Vec2 perp_normal = vec2_normal(min_normal);
+        Vec2 perp_normal = VEC2(min_normal.y, -min_normal.x); // already unit length
 
         if (vec2_dot(ac, perp_normal) > 0) {
             Vec2 contact_direction = ac;
@@ -280,13 +375,13 @@ bool collision_iscolliding_polygoncircle(Body* polygon, Body* circle, Contact* c
 bool collision_iscolliding_containerpolygon(Body* container, Body* polygon, Contact* contacts, uint32_t* num_contacts) {
     PolygonShape* polygon_shape = &polygon->shape.as.polygon;
     CircleShape* container_shape = &container->shape.as.circle;
-    Vec2Array polygon_vertices = polygon_shape->world_vertices;
+    Vec2* polygon_vertices = polygon_shape->world_vertices;
     *num_contacts = 1;
 
     Vec2 max_distance;
     float max_distance_mag = -FLT_MAX;
-    for (uint32_t i = 0; i < polygon_vertices.count; i++) {
-        Vec2 poly_vertex = polygon_vertices.items[i];
+    for (uint32_t i = 0; i < polygon_shape->count; i++) {
+        Vec2 poly_vertex = polygon_vertices[i];
         Vec2 distance = vec2_sub(container->position, poly_vertex);
         float center_vertex_distance = vec2_magnitude(distance);
         if (center_vertex_distance > max_distance_mag) {
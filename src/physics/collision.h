@@ -11,9 +11,24 @@ typedef struct {
     float depth;
 } Contact;
 
+// narrow phase result of a broad phase pair, the pairs are collided in parallel and merged in order
+typedef struct {
+    Contact contacts[2];
+    uint32_t num_contacts;
+    bool tested; // false if the pair was asleep when it was its turn
+    bool colliding;
+} PairContacts;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    PairContacts* items;
+} PairContactsArray;
+
 bool collision_iscolliding(Body* a, Body* b, Contact* contacts, uint32_t* num_contacts);
 bool collision_iscolliding_circlecircle(Body* a, Body* b, Contact* contacts, uint32_t* num_contacts);
 bool collision_iscolliding_polygonpolygon(Body* a, Body* b, Contact* contacts, uint32_t* num_contacts);
+bool collision_iscolliding_boxbox(Body* a, Body* b, Contact* contacts, uint32_t* num_contacts);
 bool collision_iscolliding_polygoncircle(Body* polygon, Body* circle, Contact* contacts, uint32_t* num_contacts);
 bool collision_iscolliding_containercircle(Body* container, Body* circle, Contact* contacts, uint32_t* num_contacts);
 bool collision_iscolliding_containerpolygon(Body* container, Body* polygon, Contact* contacts, uint32_t* num_contacts);
@@ -4,6 +4,20 @@
 #include "utils.h"
 #include <math.h>
 
+#define PENETRATION_SLOP 0.005f // penetration left to the contacts so that they stay alive
+#define RESTITUTION_SLOP 0.5f // 0.5 m/s, slower impacts don't bounce
+#define MAX_PUSH_VELOCITY 3.0f // 3 m/s, the soft contacts don't push the bodies apart faster
+
+Softness constraint_softness(float hertz, float damping_ratio, float h) {
+    if (hertz == 0.0f)
+        return (Softness) { .bias_rate = 0.0f, .mass_scale = 1.0f, .impulse_scale = 0.0f };
+    float omega = 2.0f * 3.14159265f * hertz;
+    float a1 = 2.0f * damping_ratio + h * omega;
+    float a2 = h * omega * a1;
+    float a3 = 1.0f / (1.0f + a2);
+    return (Softness) { .bias_rate = omega / a1, .mass_scale = a2 * a3, .impulse_scale = a3 };
+}
+
 void constraint_joint_init(JointConstraint* constraint, Body* a, Body* b, int a_index, int b_index, Vec2 anchor_point) {
     constraint->a_index = a_index;
     constraint->b_index = b_index;
@@ -12,6 +26,10 @@ void constraint_joint_init(JointConstraint* constraint, Body* a, Body* b, int a_
     constraint->lambda = 0;
     constraint->bias = 0;
     constraint->k = 0;
+
+    // a new joint changes how the bodies move
+    body_wake(a);
+    body_wake(b);
 }
 
 void constraint_penetration_init(PenetrationConstraint* constraint, Vec2 a_collision_point, Vec2 b_collision_point, Vec2 normal, bool persistent) {
@@ -25,7 +43,18 @@ void constraint_penetration_init(PenetrationConstraint* constraint, Vec2 a_colli
     // otherwise, we re-use the previous impulse
 }
 
-void constraint_joint_pre_solve(JointConstraint* constraint, Body* a, Body* b, float dt) {
+// same as body_apply_impulse_linear/angular, static bodies are never written
+static void solver_apply_impulse(SolverBodyArray* bodies, int index, Vec2 linear_impulse, float angular_impulse) {
+    float inv_mass = bodies->inv_mass[index];
+    if (inv_mass == 0.0f)
+        return;
+    bodies->vx[index] = bodies->vx[index] + linear_impulse.x * inv_mass;
+    bodies->vy[index] = bodies->vy[index] + linear_impulse.y * inv_mass;
+    bodies->w[index] += angular_impulse * bodies->inv_I[index];
+}
+
+// anchors and jacobian from the positions of the bodies, returns the positional error
+static float constraint_joint_compute_jacobian(JointConstraint* constraint, Body* a, Body* b, SolverBodyArray* solver_bodies) {
     // get anchor point position in world space
     Vec2 pa = body_local_to_world_space(a, constraint->a_point);
     Vec2 pb = body_local_to_world_space(b, constraint->b_point);
@@ -39,127 +68,209 @@ void constraint_joint_pre_solve(JointConstraint* constraint, Body* a, Body* b, f
     float ra_cross_pab = vec2_cross(ra, pa_pb);
     float rb_cross_pba = vec2_cross(rb, pb_pa);
 
-    float ka = vec2_dot(pa_pb, pa_pb) * a->inv_mass + ra_cross_pab * ra_cross_pab * a->inv_I;
-    float kb = vec2_dot(pb_pa, pb_pa) * b->inv_mass + rb_cross_pba * rb_cross_pba * b->inv_I;
+    float a_inv_mass = solver_bodies->inv_mass[constraint->a_index];
+    float a_inv_I = solver_bodies->inv_I[constraint->a_index];
+    float b_inv_mass = solver_bodies->inv_mass[constraint->b_index];
+    float b_inv_I = solver_bodies->inv_I[constraint->b_index];
+    float ka = vec2_dot(pa_pb, pa_pb) * a_inv_mass + ra_cross_pab * ra_cross_pab * a_inv_I;
+    float kb = vec2_dot(pb_pa, pb_pa) * b_inv_mass + rb_cross_pba * rb_cross_pba * b_inv_I;
 
     constraint->k = 4 * (ka + kb);
+    constraint->pa_pb = pa_pb;
+    constraint->ra_cross_pab = ra_cross_pab;
+    constraint->rb_cross_pba = rb_cross_pba;
 
-    // warm starting (apply cached lambda)
-    float lambda = constraint->lambda;
+    float C = vec2_dot(pb_pa, pb_pa); // positional error
+    return fmax(C, 0);
+}
+
+static void constraint_joint_apply_impulse(JointConstraint* constraint, SolverBodyArray* solver_bodies, float lambda) {
+    Vec2 pa_pb = constraint->pa_pb;
+    Vec2 pb_pa = vec2_mult(pa_pb, -1);
 
     Vec2 impulse_linear_a = vec2_mult(pa_pb, 2 * lambda);
-    float impulse_angular_a = 2 * ra_cross_pab * lambda;
+    float impulse_angular_a = 2 * constraint->ra_cross_pab * lambda;
     Vec2 impulse_linear_b = vec2_mult(pb_pa, 2 * lambda);
-    float impulse_angular_b = 2 * rb_cross_pba * lambda;
+    float impulse_angular_b = 2 * constraint->rb_cross_pba * lambda;
 
-    body_apply_impulse_linear(a, impulse_linear_a);
-    body_apply_impulse_angular(a, impulse_angular_a);
-    body_apply_impulse_linear(b, impulse_linear_b);
-    body_apply_impulse_angular(b, impulse_angular_b);
-
-    // compute bias term (baumgarte stabilization)
-    float beta = 0.2f;
-    float C = vec2_dot(pb_pa, pb_pa); // positional error
-    C = fmax(C, 0);
-    constraint->bias = (beta / dt) * C;
+    solver_apply_impulse(solver_bodies, constraint->a_index, impulse_linear_a, impulse_angular_a);
+    solver_apply_impulse(solver_bodies, constraint->b_index, impulse_linear_b, impulse_angular_b);
 }
 
-void constraint_joint_solve(JointConstraint* constraint, Body* a, Body* b) {
-    Vec2 pa = body_local_to_world_space(a, constraint->a_point);
-    Vec2 pb = body_local_to_world_space(b, constraint->b_point);
-
-    Vec2 ra = vec2_sub(pa, a->position);
-    Vec2 rb = vec2_sub(pb, b->position);
+// J*v, the jacobian is 2 * (pa - pb, ra x (pa - pb), pb - pa, rb x (pb - pa))
+static float constraint_joint_velocity(JointConstraint* constraint, SolverBodyArray* solver_bodies) {
+    int a = constraint->a_index;
+    int b = constraint->b_index;
+    Vec2 pa_pb = constraint->pa_pb;
+    Vec2 pb_pa = vec2_mult(pa_pb, -1);
+    float j_va = vec2_dot(pa_pb, VEC2(solver_bodies->vx[a], solver_bodies->vy[a])) + constraint->ra_cross_pab * solver_bodies->w[a];
+    float j_vb = vec2_dot(pb_pa, VEC2(solver_bodies->vx[b], solver_bodies->vy[b])) + constraint->rb_cross_pba * solver_bodies->w[b];
+    return 2 * (j_va + j_vb);
+}
 
-    Vec2 pa_pb = vec2_sub(pa, pb);
-    Vec2 pb_pa = vec2_sub(pb, pa);
+void constraint_joint_pre_solve(JointConstraint* constraint, Body* a, Body* b, SolverBodyArray* solver_bodies, float dt) {
+    float C = constraint_joint_compute_jacobian(constraint, a, b, solver_bodies);
 
-    float ra_cross_pab = vec2_cross(ra, pa_pb);
-    float rb_cross_pba = vec2_cross(rb, pb_pa);
+    // warm starting (apply cached lambda)
+    constraint_joint_apply_impulse(constraint, solver_bodies, constraint->lambda);
 
-    float j_va = vec2_dot(pa_pb, a->velocity) + ra_cross_pab * a->angular_velocity;
-    float j_vb = vec2_dot(pb_pa, b->velocity) + rb_cross_pba * b->angular_velocity;
-    float j_v = 2 * (j_va + j_vb);
+    // compute bias term (baumgarte stabilization)
+    float beta = 0.2f;
+    constraint->bias = (beta / dt) * C;
+}
 
+void constraint_joint_solve(JointConstraint* constraint, SolverBodyArray* solver_bodies) {
+    float j_v = constraint_joint_velocity(constraint, solver_bodies);
     float lambda = constraint->k == 0 ? 0 : -(j_v + constraint->bias) / constraint->k;
     constraint->lambda += lambda;
+    constraint_joint_apply_impulse(constraint, solver_bodies, lambda);
+}
 
-    Vec2 impulse_linear_a = vec2_mult(pa_pb, 2 * lambda);
-    float impulse_angular_a = 2 * ra_cross_pab * lambda;
-    Vec2 impulse_linear_b = vec2_mult(pb_pa, 2 * lambda);
-    float impulse_angular_b = 2 * rb_cross_pba * lambda;
+void constraint_joint_prepare(JointConstraint* constraint, Body* a, Body* b, SolverBodyArray* solver_bodies) {
+    constraint->error = constraint_joint_compute_jacobian(constraint, a, b, solver_bodies);
+}
 
-    body_apply_impulse_linear(a, impulse_linear_a);
-    body_apply_impulse_angular(a, impulse_angular_a);
-    body_apply_impulse_linear(b, impulse_linear_b);
-    body_apply_impulse_angular(b, impulse_angular_b);
+void constraint_joint_warm_start(JointConstraint* constraint, SolverBodyArray* solver_bodies) {
+    constraint_joint_apply_impulse(constraint, solver_bodies, constraint->lambda);
 }
 
-void constraint_penetration_pre_solve(PenetrationConstraint* constraint, Body* a, Body* b, float dt) {
-    Vec2 pa = constraint->a_collision_point;
-    Vec2 pb = constraint->b_collision_point;
+void constraint_joint_solve_soft(JointConstraint* constraint, SolverBodyArray* solver_bodies, Softness* softness, bool use_bias) {
+    float bias = 0.0f;
+    float mass_scale = 1.0f;
+    float impulse_scale = 0.0f;
+    if (use_bias) {
+        // the error follows the displacement of the bodies through the jacobian of the start of the step
+        int a = constraint->a_index;
+        int b = constraint->b_index;
+        Vec2 pa_pb = constraint->pa_pb;
+        float j_da = vec2_dot(pa_pb, VEC2(solver_bodies->dx[a], solver_bodies->dy[a])) + constraint->ra_cross_pab * solver_bodies->dq[a];
+        float j_db = -vec2_dot(pa_pb, VEC2(solver_bodies->dx[b], solver_bodies->dy[b])) + constraint->rb_cross_pba * solver_bodies->dq[b];
+        float C = fmaxf(constraint->error + 2 * (j_da + j_db), 0.0f);
+        bias = softness->bias_rate * C;
+        mass_scale = softness->mass_scale;
+        impulse_scale = softness->impulse_scale;
+    }
+    float j_v = constraint_joint_velocity(constraint, solver_bodies);
+    float lambda = constraint->k == 0 ? 0 : -mass_scale * (j_v + bias) / constraint->k - impulse_scale * constraint->lambda;
+    constraint->lambda += lambda;
+    constraint_joint_apply_impulse(constraint, solver_bodies, lambda);
+}
 
-    Vec2 ra = vec2_sub(pa, a->position);
-    Vec2 rb = vec2_sub(pb, b->position);
+// jacobians and effective masses from the contact points, which don't move during the step
+static void constraint_penetration_compute_jacobian(PenetrationConstraint* constraint, Body* a, Body* b,
+        SolverBodyArray* solver_bodies, int a_index, int b_index) {
+    Vec2 ra = vec2_sub(constraint->a_collision_point, a->position);
+    Vec2 rb = vec2_sub(constraint->b_collision_point, b->position);
     Vec2 normal = constraint->normal;
     float ra_cross_n = vec2_cross(ra, normal);
     float rb_cross_n = vec2_cross(rb, normal);
 
+    float a_inv_mass = solver_bodies->inv_mass[a_index];
+    float a_inv_I = solver_bodies->inv_I[a_index];
+    float b_inv_mass = solver_bodies->inv_mass[b_index];
+    float b_inv_I = solver_bodies->inv_I[b_index];
+
     // this formula is obtained by deriving J * M^(-1) * Jt
-    float k_a_n = a->inv_mass + a->inv_I * (ra_cross_n * ra_cross_n);
-    float k_b_n = b->inv_mass + b->inv_I * (rb_cross_n * rb_cross_n);
+    float k_a_n = a_inv_mass + a_inv_I * (ra_cross_n * ra_cross_n);
+    float k_b_n = b_inv_mass + b_inv_I * (rb_cross_n * rb_cross_n);
     constraint->k_normal = k_a_n + k_b_n;
 
     constraint->friction = a->friction * b->friction;
     Vec2 tangent = vec2_normal(normal);
     float ra_cross_t = vec2_cross(ra, tangent);
     float rb_cross_t = vec2_cross(rb, tangent);
-    float k_a_t = a->inv_mass + a->inv_I * (ra_cross_t * ra_cross_t);
-    float k_b_t = b->inv_mass + b->inv_I * (rb_cross_t * rb_cross_t);
+    float k_a_t = a_inv_mass + a_inv_I * (ra_cross_t * ra_cross_t);
+    float k_b_t = b_inv_mass + b_inv_I * (rb_cross_t * rb_cross_t);
     constraint->k_tangent = k_a_t + k_b_t;
 
+    // effective masses, so that the iterations multiply instead of dividing
+    constraint->normal_mass = constraint->k_normal == 0 ? 0 : 1.0f / constraint->k_normal;
+    constraint->tangent_mass = constraint->k_tangent == 0 ? 0 : 1.0f / constraint->k_tangent;
+    constraint->tangent = tangent;
+    constraint->ra_cross_n = ra_cross_n;
+    constraint->rb_cross_n = rb_cross_n;
+    constraint->ra_cross_t = ra_cross_t;
+    constraint->rb_cross_t = rb_cross_t;
+}
+
+// of the contact points along the normal, negative when they get closer
+static float constraint_penetration_relative_velocity(SolverBodyArray* solver_bodies, int a_index, int b_index,
+        Vec2 ra, Vec2 rb, Vec2 normal) {
+    float a_w = solver_bodies->w[a_index];
+    float b_w = solver_bodies->w[b_index];
+    Vec2 va = vec2_add(VEC2(solver_bodies->vx[a_index], solver_bodies->vy[a_index]), VEC2(-a_w * ra.y, a_w * ra.x));
+    Vec2 vb = vec2_add(VEC2(solver_bodies->vx[b_index], solver_bodies->vy[b_index]), VEC2(-b_w * rb.y, b_w * rb.x));
+    return vec2_dot(vec2_sub(vb, va), normal);
+}
+
+void constraint_penetration_pre_solve(PenetrationConstraint* constraint, Body* a, Body* b,
+        SolverBodyArray* solver_bodies, int a_index, int b_index, float dt) {
+    constraint_penetration_compute_jacobian(constraint, a, b, solver_bodies, a_index, b_index);
+
+    Vec2 pa = constraint->a_collision_point;
+    Vec2 pb = constraint->b_collision_point;
+    Vec2 ra = vec2_sub(pa, a->position);
+    Vec2 rb = vec2_sub(pb, b->position);
+    Vec2 normal = constraint->normal;
+    Vec2 tangent = constraint->tangent;
+
     // warm starting
     Vec2 accumulated_impulse = vec2_add(vec2_mult(normal, constraint->lambda_normal), vec2_mult(tangent, constraint->lambda_tangent));
-    body_apply_impulse_linear(a, vec2_mult(accumulated_impulse, -1));
-    body_apply_impulse_angular(a, -vec2_cross(ra, accumulated_impulse));
-    body_apply_impulse_linear(b, accumulated_impulse);
-    body_apply_impulse_angular(b, vec2_cross(rb, accumulated_impulse));
+    solver_apply_impulse(solver_bodies, a_index, vec2_mult(accumulated_impulse, -1), -vec2_cross(ra, accumulated_impulse));
+    solver_apply_impulse(solver_bodies, b_index, accumulated_impulse, vec2_cross(rb, accumulated_impulse));
 
     // compute bias term (baumgarte stabilization)
     float beta = 0.1f;
-    float penetration_slop = 0.005f;
-    float restitution_slop = 0.5f; // 0.5 m/s
     Vec2 pb_pa = vec2_sub(pb, pa);
     float C = vec2_dot(pb_pa, normal); // positional error
     // C is always < 0
-    C = fmin(C + penetration_slop, 0);
-
-    Vec2 va = vec2_add(a->velocity, VEC2(-a->angular_velocity * ra.y, a->angular_velocity * ra.x));
-    Vec2 vb = vec2_add(b->velocity, VEC2(-b->angular_velocity * rb.y, b->angular_velocity * rb.x));
-    float vrel_n = vec2_dot(vec2_sub(vb, va), normal);
+    C = fmin(C + PENETRATION_SLOP, 0);
 
-    if (fabsf(vrel_n) <= restitution_slop)
+    float vrel_n = constraint_penetration_relative_velocity(solver_bodies, a_index, b_index, ra, rb, normal);
+    if (fabsf(vrel_n) <= RESTITUTION_SLOP)
         vrel_n = 0;
     float e = a->restitution * b->restitution;
 
     constraint->bias = (beta / dt) * C + e * vrel_n;
 }
 
-void constraint_penetration_solve(PenetrationConstraint* constraint, Body* a, Body* b) {
-    Vec2 pa = constraint->a_collision_point;
-    Vec2 pb = constraint->b_collision_point;
-    Vec2 ra = vec2_sub(pa, a->position);
-    Vec2 rb = vec2_sub(pb, b->position);
+static void constraint_penetration_apply_normal_impulse(PenetrationConstraint* constraint, SolverBodyArray* solver_bodies,
+        int a_index, int b_index, float lambda_normal) {
     Vec2 normal = constraint->normal;
+    solver_apply_impulse(solver_bodies, a_index, VEC2(-normal.x * lambda_normal, -normal.y * lambda_normal), -constraint->ra_cross_n * lambda_normal);
+    solver_apply_impulse(solver_bodies, b_index, VEC2(normal.x * lambda_normal, normal.y * lambda_normal), constraint->rb_cross_n * lambda_normal);
+}
 
-    float ra_cross_n = vec2_cross(ra, normal);
-    float rb_cross_n = vec2_cross(rb, normal);
+static float constraint_penetration_normal_velocity(PenetrationConstraint* constraint, SolverBodyArray* solver_bodies, int a_index, int b_index) {
+    Vec2 normal = constraint->normal;
+    float va_n = vec2_dot(VEC2(solver_bodies->vx[a_index], solver_bodies->vy[a_index]), normal) + constraint->ra_cross_n * solver_bodies->w[a_index];
+    float vb_n = vec2_dot(VEC2(solver_bodies->vx[b_index], solver_bodies->vy[b_index]), normal) + constraint->rb_cross_n * solver_bodies->w[b_index];
+    return vb_n - va_n;
+}
+
+static void constraint_penetration_solve_friction(PenetrationConstraint* constraint, SolverBodyArray* solver_bodies, int a_index, int b_index) {
+    Vec2 tangent = constraint->tangent;
+    float ra_cross_t = constraint->ra_cross_t;
+    float rb_cross_t = constraint->rb_cross_t;
+
+    float va_t = vec2_dot(VEC2(solver_bodies->vx[a_index], solver_bodies->vy[a_index]), tangent) + ra_cross_t * solver_bodies->w[a_index];
+    float vb_t = vec2_dot(VEC2(solver_bodies->vx[b_index], solver_bodies->vy[b_index]), tangent) + rb_cross_t * solver_bodies->w[b_index];
+    float vrel_t = vb_t - va_t;
+    float lambda_tangent = -vrel_t * constraint->tangent_mass;
 
-    float va_n = vec2_dot(a->velocity, normal) + ra_cross_n * a->angular_velocity;
-    float vb_n = vec2_dot(b->velocity, normal) + rb_cross_n * b->angular_velocity;
-    float vrel_n = vb_n - va_n;
+    // clamp friction between -λn*μ and λn*μ
+    float max_friction = constraint->lambda_normal * constraint->friction; // λn*μ
+    float old_lambda_tangent = constraint->lambda_tangent;
+    constraint->lambda_tangent = clamp(constraint->lambda_tangent + lambda_tangent, -max_friction, max_friction);
+    lambda_tangent = constraint->lambda_tangent - old_lambda_tangent;
 
-    float lambda_normal = constraint->k_normal == 0 ? 0 : -(vrel_n + constraint->bias) / constraint->k_normal;
+    solver_apply_impulse(solver_bodies, a_index, VEC2(-tangent.x * lambda_tangent, -tangent.y * lambda_tangent), -ra_cross_t * lambda_tangent);
+    solver_apply_impulse(solver_bodies, b_index, VEC2(tangent.x * lambda_tangent, tangent.y * lambda_tangent), rb_cross_t * lambda_tangent);
+}
+
+void constraint_penetration_solve(PenetrationConstraint* constraint, SolverBodyArray* solver_bodies, int a_index, int b_index) {
+    float vrel_n = constraint_penetration_normal_velocity(constraint, solver_bodies, a_index, b_index);
+    float lambda_normal = -(vrel_n + constraint->bias) * constraint->normal_mass;
 
     // clamp lambda
     float old_lambda_normal = constraint->lambda_normal;
@@ -169,30 +280,67 @@ void constraint_penetration_solve(PenetrationConstraint* constraint, Body* a, Bo
         constraint->lambda_normal = 0.0f;
 
     lambda_normal = constraint->lambda_normal - old_lambda_normal;
-    body_apply_impulse_linear(a, VEC2(-normal.x * lambda_normal, -normal.y * lambda_normal));
-    body_apply_impulse_angular(a, -ra_cross_n * lambda_normal);
-    body_apply_impulse_linear(b, VEC2(normal.x * lambda_normal, normal.y * lambda_normal));
-    body_apply_impulse_angular(b, rb_cross_n * lambda_normal);
+    constraint_penetration_apply_normal_impulse(constraint, solver_bodies, a_index, b_index, lambda_normal);
+    constraint_penetration_solve_friction(constraint, solver_bodies, a_index, b_index);
+}
 
-    Vec2 tangent = vec2_normal(normal);
-    float ra_cross_t = vec2_cross(ra, tangent);
-    float rb_cross_t = vec2_cross(rb, tangent);
+void constraint_penetration_prepare(PenetrationConstraint* constraint, Body* a, Body* b,
+        SolverBodyArray* solver_bodies, int a_index, int b_index) {
+    constraint_penetration_compute_jacobian(constraint, a, b, solver_bodies, a_index, b_index);
+    Vec2 pa = constraint->a_collision_point;
+    Vec2 pb = constraint->b_collision_point;
+    constraint->separation = vec2_dot(vec2_sub(pb, pa), constraint->normal);
+    constraint->relative_velocity = constraint_penetration_relative_velocity(solver_bodies, a_index, b_index,
+        vec2_sub(pa, a->position), vec2_sub(pb, b->position), constraint->normal);
+    constraint->restitution = a->restitution * b->restitution;
+}
 
-    float va_t = vec2_dot(a->velocity, tangent) + ra_cross_t * a->angular_velocity;
-    float vb_t = vec2_dot(b->velocity, tangent) + rb_cross_t * b->angular_velocity;
-    float vrel_t = vb_t - va_t;
-    float lambda_tangent = -vrel_t / constraint->k_tangent;
+// the impulses of the previous substep (or step) are applied again
+void constraint_penetration_warm_start(PenetrationConstraint* constraint, SolverBodyArray* solver_bodies, int a_index, int b_index) {
+    float lambda_normal = constraint->lambda_normal;
+    float lambda_tangent = constraint->lambda_tangent;
+    Vec2 impulse = vec2_add(vec2_mult(constraint->normal, lambda_normal), vec2_mult(constraint->tangent, lambda_tangent));
+    solver_apply_impulse(solver_bodies, a_index, vec2_mult(impulse, -1),
+        -(constraint->ra_cross_n * lambda_normal + constraint->ra_cross_t * lambda_tangent));
+    solver_apply_impulse(solver_bodies, b_index, impulse, constraint->rb_cross_n * lambda_normal + constraint->rb_cross_t * lambda_tangent);
+}
 
-    // clamp friction between -λn*μ and λn*μ
-    float max_friction = constraint->lambda_normal * constraint->friction; // λn*μ
-    float old_lambda_tangent = constraint->lambda_tangent;
-    constraint->lambda_tangent = clamp(constraint->lambda_tangent + lambda_tangent, -max_friction, max_friction);
-    lambda_tangent = constraint->lambda_tangent - old_lambda_tangent;
+void constraint_penetration_solve_soft(PenetrationConstraint* constraint, SolverBodyArray* solver_bodies, int a_index, int b_index,
+        Softness* softness, float inv_h, bool use_bias) {
+    // the separation follows the displacement of the bodies through the jacobian of the start of the step
+    Vec2 normal = constraint->normal;
+    float da = vec2_dot(VEC2(solver_bodies->dx[a_index], solver_bodies->dy[a_index]), normal) + constraint->ra_cross_n * solver_bodies->dq[a_index];
+    float db = vec2_dot(VEC2(solver_bodies->dx[b_index], solver_bodies->dy[b_index]), normal) + constraint->rb_cross_n * solver_bodies->dq[b_index];
+    float separation = constraint->separation + db - da;
+
+    float bias = 0.0f;
+    float mass_scale = 1.0f;
+    float impulse_scale = 0.0f;
+    if (separation > 0.0f) {
+        // apart, the bodies can still get closer by the separation during this substep
+        bias = separation * inv_h;
+    } else if (use_bias) {
+        bias = fmaxf(softness->bias_rate * fminf(separation + PENETRATION_SLOP, 0.0f), -MAX_PUSH_VELOCITY);
+        mass_scale = softness->mass_scale;
+        impulse_scale = softness->impulse_scale;
+    }
 
-    body_apply_impulse_linear(a, VEC2(-tangent.x * lambda_tangent, -tangent.y * lambda_tangent));
-    body_apply_impulse_angular(a, -ra_cross_t * lambda_tangent);
-    body_apply_impulse_linear(b, VEC2(tangent.x * lambda_tangent, tangent.y * lambda_tangent));
-    body_apply_impulse_angular(b, rb_cross_t * lambda_tangent);
+    float vrel_n = constraint_penetration_normal_velocity(constraint, solver_bodies, a_index, b_index);
+    float lambda_normal = -constraint->normal_mass * mass_scale * (vrel_n + bias) - impulse_scale * constraint->lambda_normal;
+    float old_lambda_normal = constraint->lambda_normal;
+    constraint->lambda_normal = fmaxf(old_lambda_normal + lambda_normal, 0.0f);
+    lambda_normal = constraint->lambda_normal - old_lambda_normal;
+    constraint_penetration_apply_normal_impulse(constraint, solver_bodies, a_index, b_index, lambda_normal);
+    constraint_penetration_solve_friction(constraint, solver_bodies, a_index, b_index);
 }
 
-
+void constraint_penetration_restitution(PenetrationConstraint* constraint, SolverBodyArray* solver_bodies, int a_index, int b_index) {
+    if (constraint->restitution == 0.0f || constraint->relative_velocity > -RESTITUTION_SLOP || constraint->lambda_normal == 0.0f)
+        return;
+    float vrel_n = constraint_penetration_normal_velocity(constraint, solver_bodies, a_index, b_index);
+    float lambda_normal = -constraint->normal_mass * (vrel_n + constraint->restitution * constraint->relative_velocity);
+    float old_lambda_normal = constraint->lambda_normal;
+    constraint->lambda_normal = fmaxf(old_lambda_normal + lambda_normal, 0.0f);
+    lambda_normal = constraint->lambda_normal - old_lambda_normal;
+    constraint_penetration_apply_normal_impulse(constraint, solver_bodies, a_index, b_index, lambda_normal);
+}
@@ -2,6 +2,7 @@
 #define CONSTRAINT_H
 
 #include "body.h"
+#include "solver.h"
 
 typedef struct {
     int a_index; // index of body A in the world's bodies array
@@ -11,6 +12,11 @@ typedef struct {
     float k; // J*M_inv*Jt
     float lambda;
     float bias;
+    // computed once per step in the pre-solve, positions don't change during the iterations
+    Vec2 pa_pb; // from anchor B to anchor A in world space
+    float ra_cross_pab;
+    float rb_cross_pba;
+    float error; // positional error at the start of the step, for the substep solver
 } JointConstraint;
 
 typedef struct {
@@ -23,6 +29,18 @@ typedef struct {
     float lambda_tangent; // impulse magnitude along tangent
     float bias;
     float friction; // friction coefficient between the two penetrating bodies
+    // computed once per step in the pre-solve
+    Vec2 tangent;
+    float ra_cross_n;
+    float rb_cross_n;
+    float ra_cross_t;
+    float rb_cross_t;
+    float normal_mass; // 1 / k_normal
+    float tangent_mass; // 1 / k_tangent
+    // for the substep solver
+    float separation; // at the start of the step, negative when penetrating
+    float relative_velocity; // along the normal before solving, bounced back by the restitution
+    float restitution;
 } PenetrationConstraint;
 
 typedef struct {
@@ -37,12 +55,37 @@ typedef struct {
     PenetrationConstraint* items;
 } PenetrationConstraintArray;
 
+// a soft constraint behaves like a spring of the given frequency and damping ratio instead of fixing the whole
+// error at once, which keeps stiff stacks stable with a single iteration per substep (from Box2D's soft step).
+// The scales are for substeps of h seconds
+typedef struct {
+    float bias_rate; // velocity per unit of error
+    float mass_scale;
+    float impulse_scale;
+} Softness;
+
+Softness constraint_softness(float hertz, float damping_ratio, float h);
+
 void constraint_joint_init(JointConstraint* constraint, Body* a, Body* b, int a_index, int b_index, Vec2 anchor_point);
-void constraint_joint_solve(JointConstraint* constraint, Body* a, Body* b);
-void constraint_joint_pre_solve(JointConstraint* constraint, Body* a, Body* b, float dt);
+// the pre-solve reads the positions from the bodies, velocities are read and written in the solver bodies
+void constraint_joint_pre_solve(JointConstraint* constraint, Body* a, Body* b, SolverBodyArray* solver_bodies, float dt);
+void constraint_joint_solve(JointConstraint* constraint, SolverBodyArray* solver_bodies);
+// the substep solver computes the jacobians once per step, the error is then updated from the displacement of
+// the bodies in the solver bodies. The relax iterations (use_bias false) remove the velocity added by the bias
+void constraint_joint_prepare(JointConstraint* constraint, Body* a, Body* b, SolverBodyArray* solver_bodies);
+void constraint_joint_warm_start(JointConstraint* constraint, SolverBodyArray* solver_bodies);
+void constraint_joint_solve_soft(JointConstraint* constraint, SolverBodyArray* solver_bodies, Softness* softness, bool use_bias);
 
 void constraint_penetration_init(PenetrationConstraint* constraint, Vec2 a_collision_point, Vec2 b_collision_point, Vec2 normal, bool persistent);
-void constraint_penetration_pre_solve(PenetrationConstraint* constraint, Body* a, Body* b, float dt);
-void constraint_penetration_solve(PenetrationConstraint* constraint, Body* a, Body* b);
+void constraint_penetration_pre_solve(PenetrationConstraint* constraint, Body* a, Body* b,
+        SolverBodyArray* solver_bodies, int a_index, int b_index, float dt);
+void constraint_penetration_solve(PenetrationConstraint* constraint, SolverBodyArray* solver_bodies, int a_index, int b_index);
+void constraint_penetration_prepare(PenetrationConstraint* constraint, Body* a, Body* b,
+        SolverBodyArray* solver_bodies, int a_index, int b_index);
+void constraint_penetration_warm_start(PenetrationConstraint* constraint, SolverBodyArray* solver_bodies, int a_index, int b_index);
+void constraint_penetration_solve_soft(PenetrationConstraint* constraint, SolverBodyArray* solver_bodies, int a_index, int b_index,
+        Softness* softness, float inv_h, bool use_bias);
+// once after the last substep, with the velocities of the end of the step
+void constraint_penetration_restitution(PenetrationConstraint* constraint, SolverBodyArray* solver_bodies, int a_index, int b_index);
 
 #endif // CONSTRAINT_H
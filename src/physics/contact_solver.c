@@ -0,0 +1,269 @@
+#include "contact_solver.h"
+#include "constraint.h"
+#include "manifold.h"
+#include "solver.h"
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CONTACT_SOLVER_AVX2 1
+#if defined(__SSE2__)
+#define CONTACT_SOLVER_SSE2 1
+#endif
+#endif
+
+// velocities of the bodies of each lane, copied out of the solver bodies
+typedef struct {
+    float vx[CONTACT_SOLVER_MAX_LANES];
+    float vy[CONTACT_SOLVER_MAX_LANES];
+    float w[CONTACT_SOLVER_MAX_LANES];
+} LaneVelocities;
+
+static void contact_solver_gather(LaneVelocities* v, const int32_t* indices, SolverBodyArray* bodies, uint32_t lanes) {
+    for (uint32_t l = 0; l < lanes; l++) {
+        int32_t i = indices[l];
+        v->vx[l] = i < 0 ? 0.0f : bodies->vx[i];
+        v->vy[l] = i < 0 ? 0.0f : bodies->vy[i];
+        v->w[l] = i < 0 ? 0.0f : bodies->w[i];
+    }
+}
+
+// static bodies can be shared by several lanes and are never written
+static void contact_solver_scatter(const LaneVelocities* v, const int32_t* indices, const float* inv_mass,
+        SolverBodyArray* bodies, uint32_t lanes) {
+    for (uint32_t l = 0; l < lanes; l++) {
+        int32_t i = indices[l];
+        if (i < 0 || inv_mass[l] == 0.0f)
+            continue;
+        bodies->vx[i] = v->vx[l];
+        bodies->vy[i] = v->vy[l];
+        bodies->w[i] = v->w[l];
+    }
+}
+
+// same operations, in the same order, as constraint_penetration_solve
+#ifdef CONTACT_SOLVER_SSE2
+static void contact_solver_solve_sse2(ContactRow* rows, uint32_t count, SolverBodyArray* bodies) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    LaneVelocities va, vb;
+    for (uint32_t r = 0; r < count; r++) {
+        ContactRow* row = &rows[r];
+        contact_solver_gather(&va, row->a_index, bodies, 4);
+        contact_solver_gather(&vb, row->b_index, bodies, 4);
+        __m128 va_x = _mm_loadu_ps(va.vx), va_y = _mm_loadu_ps(va.vy), va_w = _mm_loadu_ps(va.w);
+        __m128 vb_x = _mm_loadu_ps(vb.vx), vb_y = _mm_loadu_ps(vb.vy), vb_w = _mm_loadu_ps(vb.w);
+        __m128 a_inv_mass = _mm_loadu_ps(row->a_inv_mass), a_inv_I = _mm_loadu_ps(row->a_inv_I);
+        __m128 b_inv_mass = _mm_loadu_ps(row->b_inv_mass), b_inv_I = _mm_loadu_ps(row->b_inv_I);
+
+        // normal impulse, the accumulated one can't pull the bodies together
+        __m128 n_x = _mm_loadu_ps(row->normal_x), n_y = _mm_loadu_ps(row->normal_y);
+        __m128 ra_cross_n = _mm_loadu_ps(row->ra_cross_n), rb_cross_n = _mm_loadu_ps(row->rb_cross_n);
+        __m128 va_n = _mm_add_ps(_mm_add_ps(_mm_mul_ps(va_x, n_x), _mm_mul_ps(va_y, n_y)), _mm_mul_ps(ra_cross_n, va_w));
+        __m128 vb_n = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vb_x, n_x), _mm_mul_ps(vb_y, n_y)), _mm_mul_ps(rb_cross_n, vb_w));
+        __m128 vrel_n = _mm_sub_ps(vb_n, va_n);
+        __m128 lambda_normal = _mm_mul_ps(_mm_xor_ps(_mm_add_ps(vrel_n, _mm_loadu_ps(row->bias)), sign), _mm_loadu_ps(row->normal_mass));
+        __m128 old_lambda_normal = _mm_loadu_ps(row->lambda_normal);
+        __m128 accumulated_normal = _mm_max_ps(zero, _mm_add_ps(old_lambda_normal, lambda_normal));
+        _mm_storeu_ps(row->lambda_normal, accumulated_normal);
+        lambda_normal = _mm_sub_ps(accumulated_normal, old_lambda_normal);
+
+        __m128 j_x = _mm_mul_ps(n_x, lambda_normal), j_y = _mm_mul_ps(n_y, lambda_normal);
+        va_x = _mm_add_ps(va_x, _mm_mul_ps(_mm_mul_ps(_mm_xor_ps(n_x, sign), lambda_normal), a_inv_mass));
+        va_y = _mm_add_ps(va_y, _mm_mul_ps(_mm_mul_ps(_mm_xor_ps(n_y, sign), lambda_normal), a_inv_mass));
+        va_w = _mm_add_ps(va_w, _mm_mul_ps(_mm_mul_ps(_mm_xor_ps(ra_cross_n, sign), lambda_normal), a_inv_I));
+        vb_x = _mm_add_ps(vb_x, _mm_mul_ps(j_x, b_inv_mass));
+        vb_y = _mm_add_ps(vb_y, _mm_mul_ps(j_y, b_inv_mass));
+        vb_w = _mm_add_ps(vb_w, _mm_mul_ps(_mm_mul_ps(rb_cross_n, lambda_normal), b_inv_I));
+
+        // friction impulse, clamped between -λn*μ and λn*μ
+        __m128 t_x = _mm_loadu_ps(row->tangent_x), t_y = _mm_loadu_ps(row->tangent_y);
+        __m128 ra_cross_t = _mm_loadu_ps(row->ra_cross_t), rb_cross_t = _mm_loadu_ps(row->rb_cross_t);
+        __m128 va_t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(va_x, t_x), _mm_mul_ps(va_y, t_y)), _mm_mul_ps(ra_cross_t, va_w));
+        __m128 vb_t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vb_x, t_x), _mm_mul_ps(vb_y, t_y)), _mm_mul_ps(rb_cross_t, vb_w));
+        __m128 vrel_t = _mm_sub_ps(vb_t, va_t);
+        __m128 lambda_tangent = _mm_mul_ps(_mm_xor_ps(vrel_t, sign), _mm_loadu_ps(row->tangent_mass));
+        __m128 max_friction = _mm_mul_ps(accumulated_normal, _mm_loadu_ps(row->friction));
+        __m128 old_lambda_tangent = _mm_loadu_ps(row->lambda_tangent);
+        __m128 accumulated_tangent = _mm_max_ps(
+            _mm_min_ps(_mm_add_ps(old_lambda_tangent, lambda_tangent), max_friction), _mm_xor_ps(max_friction, sign));
+        _mm_storeu_ps(row->lambda_tangent, accumulated_tangent);
+        lambda_tangent = _mm_sub_ps(accumulated_tangent, old_lambda_tangent);
+
+        j_x = _mm_mul_ps(t_x, lambda_tangent);
+        j_y = _mm_mul_ps(t_y, lambda_tangent);
+        va_x = _mm_add_ps(va_x, _mm_mul_ps(_mm_mul_ps(_mm_xor_ps(t_x, sign), lambda_tangent), a_inv_mass));
+        va_y = _mm_add_ps(va_y, _mm_mul_ps(_mm_mul_ps(_mm_xor_ps(t_y, sign), lambda_tangent), a_inv_mass));
+        va_w = _mm_add_ps(va_w, _mm_mul_ps(_mm_mul_ps(_mm_xor_ps(ra_cross_t, sign), lambda_tangent), a_inv_I));
+        vb_x = _mm_add_ps(vb_x, _mm_mul_ps(j_x, b_inv_mass));
+        vb_y = _mm_add_ps(vb_y, _mm_mul_ps(j_y, b_inv_mass));
+        vb_w = _mm_add_ps(vb_w, _mm_mul_ps(_mm_mul_ps(rb_cross_t, lambda_tangent), b_inv_I));
+
+        _mm_storeu_ps(va.vx, va_x);
+        _mm_storeu_ps(va.vy, va_y);
+        _mm_storeu_ps(va.w, va_w);
+        _mm_storeu_ps(vb.vx, vb_x);
+        _mm_storeu_ps(vb.vy, vb_y);
+        _mm_storeu_ps(vb.w, vb_w);
+        contact_solver_scatter(&va, row->a_index, row->a_inv_mass, bodies, 4);
+        contact_solver_scatter(&vb, row->b_index, row->b_inv_mass, bodies, 4);
+    }
+}
+#endif
+
+#ifdef CONTACT_SOLVER_AVX2
+__attribute__((target("avx2")))
+static void contact_solver_solve_avx2(ContactRow* rows, uint32_t count, SolverBodyArray* bodies) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    LaneVelocities va, vb;
+    for (uint32_t r = 0; r < count; r++) {
+        ContactRow* row = &rows[r];
+        contact_solver_gather(&va, row->a_index, bodies, 8);
+        contact_solver_gather(&vb, row->b_index, bodies, 8);
+        __m256 va_x = _mm256_loadu_ps(va.vx), va_y = _mm256_loadu_ps(va.vy), va_w = _mm256_loadu_ps(va.w);
+        __m256 vb_x = _mm256_loadu_ps(vb.vx), vb_y = _mm256_loadu_ps(vb.vy), vb_w = _mm256_loadu_ps(vb.w);
+        __m256 a_inv_mass = _mm256_loadu_ps(row->a_inv_mass), a_inv_I = _mm256_loadu_ps(row->a_inv_I);
+        __m256 b_inv_mass = _mm256_loadu_ps(row->b_inv_mass), b_inv_I = _mm256_loadu_ps(row->b_inv_I);
+
+        // normal impulse, the accumulated one can't pull the bodies together
+        __m256 n_x = _mm256_loadu_ps(row->normal_x), n_y = _mm256_loadu_ps(row->normal_y);
+        __m256 ra_cross_n = _mm256_loadu_ps(row->ra_cross_n), rb_cross_n = _mm256_loadu_ps(row->rb_cross_n);
+        __m256 va_n = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(va_x, n_x), _mm256_mul_ps(va_y, n_y)), _mm256_mul_ps(ra_cross_n, va_w));
+        __m256 vb_n = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vb_x, n_x), _mm256_mul_ps(vb_y, n_y)), _mm256_mul_ps(rb_cross_n, vb_w));
+        __m256 vrel_n = _mm256_sub_ps(vb_n, va_n);
+        __m256 lambda_normal = _mm256_mul_ps(_mm256_xor_ps(_mm256_add_ps(vrel_n, _mm256_loadu_ps(row->bias)), sign), _mm256_loadu_ps(row->normal_mass));
+        __m256 old_lambda_normal = _mm256_loadu_ps(row->lambda_normal);
+        __m256 accumulated_normal = _mm256_max_ps(zero, _mm256_add_ps(old_lambda_normal, lambda_normal));
+        _mm256_storeu_ps(row->lambda_normal, accumulated_normal);
+        lambda_normal = _mm256_sub_ps(accumulated_normal, old_lambda_normal);
+
+        __m256 j_x = _mm256_mul_ps(n_x, lambda_normal), j_y = _mm256_mul_ps(n_y, lambda_normal);
+        va_x = _mm256_add_ps(va_x, _mm256_mul_ps(_mm256_mul_ps(_mm256_xor_ps(n_x, sign), lambda_normal), a_inv_mass));
+        va_y = _mm256_add_ps(va_y, _mm256_mul_ps(_mm256_mul_ps(_mm256_xor_ps(n_y, sign), lambda_normal), a_inv_mass));
+        va_w = _mm256_add_ps(va_w, _mm256_mul_ps(_mm256_mul_ps(_mm256_xor_ps(ra_cross_n, sign), lambda_normal), a_inv_I));
+        vb_x = _mm256_add_ps(vb_x, _mm256_mul_ps(j_x, b_inv_mass));
+        vb_y = _mm256_add_ps(vb_y, _mm256_mul_ps(j_y, b_inv_mass));
+        vb_w = _mm256_add_ps(vb_w, _mm256_mul_ps(_mm256_mul_ps(rb_cross_n, lambda_normal), b_inv_I));
+
+        // friction impulse, clamped between -λn*μ and λn*μ
+        __m256 t_x = _mm256_loadu_ps(row->tangent_x), t_y = _mm256_loadu_ps(row->tangent_y);
+        __m256 ra_cross_t = _mm256_loadu_ps(row->ra_cross_t), rb_cross_t = _mm256_loadu_ps(row->rb_cross_t);
+        __m256 va_t = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(va_x, t_x), _mm256_mul_ps(va_y, t_y)), _mm256_mul_ps(ra_cross_t, va_w));
+        __m256 vb_t = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vb_x, t_x), _mm256_mul_ps(vb_y, t_y)), _mm256_mul_ps(rb_cross_t, vb_w));
+        __m256 vrel_t = _mm256_sub_ps(vb_t, va_t);
+        __m256 lambda_tangent = _mm256_mul_ps(_mm256_xor_ps(vrel_t, sign), _mm256_loadu_ps(row->tangent_mass));
+        __m256 max_friction = _mm256_mul_ps(accumulated_normal, _mm256_loadu_ps(row->friction));
+        __m256 old_lambda_tangent = _mm256_loadu_ps(row->lambda_tangent);
+        __m256 accumulated_tangent = _mm256_max_ps(
+            _mm256_min_ps(_mm256_add_ps(old_lambda_tangent, lambda_tangent), max_friction), _mm256_xor_ps(max_friction, sign));
+        _mm256_storeu_ps(row->lambda_tangent, accumulated_tangent);
+        lambda_tangent = _mm256_sub_ps(accumulated_tangent, old_lambda_tangent);
+
+        j_x = _mm256_mul_ps(t_x, lambda_tangent);
+        j_y = _mm256_mul_ps(t_y, lambda_tangent);
+        va_x = _mm256_add_ps(va_x, _mm256_mul_ps(_mm256_mul_ps(_mm256_xor_ps(t_x, sign), lambda_tangent), a_inv_mass));
+        va_y = _mm256_add_ps(va_y, _mm256_mul_ps(_mm256_mul_ps(_mm256_xor_ps(t_y, sign), lambda_tangent), a_inv_mass));
+        va_w = _mm256_add_ps(va_w, _mm256_mul_ps(_mm256_mul_ps(_mm256_xor_ps(ra_cross_t, sign), lambda_tangent), a_inv_I));
+        vb_x = _mm256_add_ps(vb_x, _mm256_mul_ps(j_x, b_inv_mass));
+        vb_y = _mm256_add_ps(vb_y, _mm256_mul_ps(j_y, b_inv_mass));
+        vb_w = _mm256_add_ps(vb_w, _mm256_mul_ps(_mm256_mul_ps(rb_cross_t, lambda_tangent), b_inv_I));
+
+        _mm256_storeu_ps(va.vx, va_x);
+        _mm256_storeu_ps(va.vy, va_y);
+        _mm256_storeu_ps(va.w, va_w);
+        _mm256_storeu_ps(vb.vx, vb_x);
+        _mm256_storeu_ps(vb.vy, vb_y);
+        _mm256_storeu_ps(vb.w, vb_w);
+        contact_solver_scatter(&va, row->a_index, row->a_inv_mass, bodies, 8);
+        contact_solver_scatter(&vb, row->b_index, row->b_inv_mass, bodies, 8);
+    }
+}
+#endif
+
+void contact_solver_init(ContactSolver* solver, bool simd) {
+    solver->lanes = 1;
+    solver->solve = NULL;
+    if (!simd)
+        return;
+#ifdef CONTACT_SOLVER_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        solver->lanes = 8;
+        solver->solve = contact_solver_solve_avx2;
+        return;
+    }
+#endif
+#ifdef CONTACT_SOLVER_SSE2
+    solver->lanes = 4;
+    solver->solve = contact_solver_solve_sse2;
+#endif
+}
+
+uint32_t contact_solver_max_rows(ContactSolver* solver, uint32_t count) {
+    return MAX_CONTACTS * ((count + solver->lanes - 1) / solver->lanes);
+}
+
+// manifolds go in groups of lanes, with one row for each of the contacts of the group.
+// The contacts of a manifold share its bodies so they are solved one row after the other
+uint32_t contact_solver_pack(ContactSolver* solver, ContactRow* rows, Manifold** manifolds, uint32_t count, SolverBodyArray* bodies) {
+    uint32_t lanes = solver->lanes;
+    uint32_t num_rows = 0;
+    for (uint32_t start = 0; start < count; start += lanes) {
+        uint32_t group_count = count - start < lanes ? count - start : lanes;
+        for (int c = 0; c < MAX_CONTACTS; c++) {
+            bool used = false;
+            for (uint32_t l = 0; l < group_count; l++) {
+                used |= manifolds[start + l]->num_contacts > c;
+            }
+            if (!used)
+                break;
+            ContactRow* row = &rows[num_rows++];
+            memset(row, 0, sizeof *row);
+            for (uint32_t l = 0; l < lanes; l++) {
+                Manifold* manifold = l < group_count ? manifolds[start + l] : NULL;
+                if (manifold == NULL || manifold->num_contacts <= c) {
+                    row->a_index[l] = -1;
+                    row->b_index[l] = -1;
+                    continue;
+                }
+                PenetrationConstraint* constraint = &manifold->constraints[c];
+                row->a_index[l] = manifold->a_index;
+                row->b_index[l] = manifold->b_index;
+                row->normal_x[l] = constraint->normal.x;
+                row->normal_y[l] = constraint->normal.y;
+                row->tangent_x[l] = constraint->tangent.x;
+                row->tangent_y[l] = constraint->tangent.y;
+                row->ra_cross_n[l] = constraint->ra_cross_n;
+                row->rb_cross_n[l] = constraint->rb_cross_n;
+                row->ra_cross_t[l] = constraint->ra_cross_t;
+                row->rb_cross_t[l] = constraint->rb_cross_t;
+                row->normal_mass[l] = constraint->normal_mass;
+                row->tangent_mass[l] = constraint->tangent_mass;
+                row->bias[l] = constraint->bias;
+                row->friction[l] = constraint->friction;
+                row->lambda_normal[l] = constraint->lambda_normal;
+                row->lambda_tangent[l] = constraint->lambda_tangent;
+                row->a_inv_mass[l] = bodies->inv_mass[manifold->a_index];
+                row->a_inv_I[l] = bodies->inv_I[manifold->a_index];
+                row->b_inv_mass[l] = bodies->inv_mass[manifold->b_index];
+                row->b_inv_I[l] = bodies->inv_I[manifold->b_index];
+                row->constraints[l] = constraint;
+            }
+        }
+    }
+    return num_rows;
+}
+
+void contact_solver_store(ContactSolver* solver, ContactRow* rows, uint32_t count) {
+    for (uint32_t r = 0; r < count; r++) {
+        for (uint32_t l = 0; l < solver->lanes; l++) {
+            PenetrationConstraint* constraint = rows[r].constraints[l];
+            if (constraint == NULL)
+                continue;
+            constraint->lambda_normal = rows[r].lambda_normal[l];
+            constraint->lambda_tangent = rows[r].lambda_tangent[l];
+        }
+    }
+}
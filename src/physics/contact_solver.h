@@ -0,0 +1,60 @@
+#ifndef CONTACT_SOLVER_H
+#define CONTACT_SOLVER_H
+
+#include "constraint.h"
+#include "manifold.h"
+#include "solver.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CONTACT_SOLVER_MAX_LANES 8
+
+// contacts of up to 8 manifolds that don't share any non static body, solved together with simd.
+// Lanes that are not used have a body index of -1
+typedef struct {
+    int32_t a_index[CONTACT_SOLVER_MAX_LANES];
+    int32_t b_index[CONTACT_SOLVER_MAX_LANES];
+    float normal_x[CONTACT_SOLVER_MAX_LANES];
+    float normal_y[CONTACT_SOLVER_MAX_LANES];
+    float tangent_x[CONTACT_SOLVER_MAX_LANES];
+    float tangent_y[CONTACT_SOLVER_MAX_LANES];
+    float ra_cross_n[CONTACT_SOLVER_MAX_LANES];
+    float rb_cross_n[CONTACT_SOLVER_MAX_LANES];
+    float ra_cross_t[CONTACT_SOLVER_MAX_LANES];
+    float rb_cross_t[CONTACT_SOLVER_MAX_LANES];
+    float normal_mass[CONTACT_SOLVER_MAX_LANES];
+    float tangent_mass[CONTACT_SOLVER_MAX_LANES];
+    float bias[CONTACT_SOLVER_MAX_LANES];
+    float friction[CONTACT_SOLVER_MAX_LANES];
+    float lambda_normal[CONTACT_SOLVER_MAX_LANES];
+    float lambda_tangent[CONTACT_SOLVER_MAX_LANES];
+    float a_inv_mass[CONTACT_SOLVER_MAX_LANES];
+    float a_inv_I[CONTACT_SOLVER_MAX_LANES];
+    float b_inv_mass[CONTACT_SOLVER_MAX_LANES];
+    float b_inv_I[CONTACT_SOLVER_MAX_LANES];
+    PenetrationConstraint* constraints[CONTACT_SOLVER_MAX_LANES]; // where the impulses are stored back
+} ContactRow;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    ContactRow* items;
+} ContactRowArray;
+
+typedef void ContactSolveFn(ContactRow* rows, uint32_t count, SolverBodyArray* bodies);
+
+typedef struct {
+    uint32_t lanes; // contacts per row, 1 when there is no simd support
+    ContactSolveFn* solve; // NULL when there is no simd support
+} ContactSolver;
+
+// picks the widest implementation supported by the cpu, or none if simd is false
+void contact_solver_init(ContactSolver* solver, bool simd);
+// rows needed for count manifolds
+uint32_t contact_solver_max_rows(ContactSolver* solver, uint32_t count);
+// the constraints must be pre-solved, the manifolds can't share any non static body. Returns the rows written
+uint32_t contact_solver_pack(ContactSolver* solver, ContactRow* rows, Manifold** manifolds, uint32_t count, SolverBodyArray* bodies);
+// copies the accumulated impulses back into the constraints, for warm starting
+void contact_solver_store(ContactSolver* solver, ContactRow* rows, uint32_t count);
+
+#endif // CONTACT_SOLVER_H
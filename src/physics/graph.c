@@ -0,0 +1,99 @@
+#include "graph.h"
+#include "array.h"
+#include "body.h"
+#include "world.h"
+
+void graph_init(ConstraintGraph* graph) {
+    graph->constraints = (IntArray) DA_NULL;
+    graph->num_colors = 0;
+    graph->body_masks = (MaskArray) DA_NULL;
+    graph->constraint_colors = (IntArray) DA_NULL;
+}
+
+void graph_free(ConstraintGraph* graph) {
+    DA_FREE(&graph->constraints);
+    DA_FREE(&graph->body_masks);
+    DA_FREE(&graph->constraint_colors);
+}
+
+static void graph_constraint_bodies(struct World* world, Island* island, uint32_t k, int* a_index, int* b_index) {
+    IslandSet* islands = &world->islands;
+    if (k < island->joint_count) {
+        JointConstraint* joint = &world->joint_constraints.items[islands->joints.items[island->joint_start + k]];
+        *a_index = joint->a_index;
+        *b_index = joint->b_index;
+    } else {
+        int index = islands->manifolds.items[island->manifold_start + k - island->joint_count];
+        Manifold* manifold = &world->manifolds.items[index];
+        *a_index = manifold->a_index;
+        *b_index = manifold->b_index;
+    }
+}
+
+static int graph_first_free_color(uint64_t used) {
+    if (used == UINT64_MAX)
+        return GRAPH_OVERFLOW_COLOR;
+    return __builtin_ctzll(~used);
+}
+
+void graph_color(ConstraintGraph* graph, struct World* world, Island* island) {
+    BodyArray bodies = world->bodies;
+    uint32_t num_constraints = island->joint_count + island->manifold_count;
+
+    // masks start cleared and are cleared again at the end, only for the bodies of this island
+    while (graph->body_masks.count < bodies.count) {
+        DA_APPEND(&graph->body_masks, 0);
+    }
+    uint64_t* masks = graph->body_masks.items;
+
+    // greedy coloring in constraint order: take the first color that none of the bodies uses.
+    // Static bodies are never written by the solver, so they can be shared
+    for (uint32_t c = 0; c < GRAPH_MAX_COLORS + 2; c++) {
+        graph->color_start[c] = 0;
+    }
+    DA_RESERVE(&graph->constraint_colors, num_constraints);
+    graph->constraint_colors.count = num_constraints;
+    graph->num_colors = 0;
+    for (uint32_t k = 0; k < num_constraints; k++) {
+        int a_index, b_index;
+        graph_constraint_bodies(world, island, k, &a_index, &b_index);
+        bool a_is_static = body_is_static(&bodies.items[a_index]);
+        bool b_is_static = body_is_static(&bodies.items[b_index]);
+        uint64_t used = (a_is_static ? 0 : masks[a_index]) | (b_is_static ? 0 : masks[b_index]);
+        int color = graph_first_free_color(used);
+        if (color != GRAPH_OVERFLOW_COLOR) {
+            uint64_t bit = (uint64_t) 1 << color;
+            if (!a_is_static)
+                masks[a_index] |= bit;
+            if (!b_is_static)
+                masks[b_index] |= bit;
+            if ((uint32_t) color + 1 > graph->num_colors)
+                graph->num_colors = color + 1;
+        }
+        graph->constraint_colors.items[k] = color;
+        graph->color_start[color + 1]++;
+    }
+
+    for (uint32_t b = 0; b < island->body_count; b++) {
+        masks[world->islands.bodies.items[island->body_start + b]] = 0;
+    }
+
+    // counting sort of the constraints by color, keeping their order inside each color
+    for (uint32_t c = 0; c < GRAPH_MAX_COLORS + 1; c++) {
+        graph->color_start[c + 1] += graph->color_start[c];
+    }
+    DA_RESERVE(&graph->constraints, num_constraints);
+    graph->constraints.count = num_constraints;
+    for (uint32_t k = 0; k < num_constraints; k++) {
+        int color = graph->constraint_colors.items[k];
+        graph->constraints.items[graph->color_start[color]++] = k;
+    }
+    for (uint32_t c = GRAPH_MAX_COLORS + 1; c > 0; c--) {
+        graph->color_start[c] = graph->color_start[c - 1];
+    }
+    graph->color_start[0] = 0;
+}
+
+uint32_t graph_color_count(ConstraintGraph* graph, uint32_t color) {
+    return graph->color_start[color + 1] - graph->color_start[color];
+}
@@ -0,0 +1,35 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include "array.h"
+#include "island.h"
+#include <stdint.h>
+
+#define GRAPH_MAX_COLORS 64 // one bit per color in the body masks
+#define GRAPH_OVERFLOW_COLOR GRAPH_MAX_COLORS // constraints that didn't fit in any color
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    uint64_t* items;
+} MaskArray;
+
+// constraint graph coloring of an island: constraints with the same color don't share any
+// non static body, so each color can be solved in parallel without locks.
+// Constraints are identified by their index in the island, joints first and then manifolds
+typedef struct {
+    IntArray constraints; // island constraints sorted by color
+    uint32_t color_start[GRAPH_MAX_COLORS + 2]; // start of each color in constraints, the overflow is the last one
+    uint32_t num_colors; // colors in use, not counting the overflow
+    MaskArray body_masks; // colors used by each body, indexed like the world's bodies
+    IntArray constraint_colors; // scratch
+} ConstraintGraph;
+
+struct World;
+
+void graph_init(ConstraintGraph* graph);
+void graph_free(ConstraintGraph* graph);
+void graph_color(ConstraintGraph* graph, struct World* world, Island* island);
+uint32_t graph_color_count(ConstraintGraph* graph, uint32_t color);
+
+#endif // GRAPH_H
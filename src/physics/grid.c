@@ -0,0 +1,290 @@
+#include "grid.h"
+#include "aabb.h"
+#include "array.h"
+#include "body.h"
+#include <math.h>
+
+#define GRID_CELL_SCALE 2.0f // cell size relative to the median body extent
+#define GRID_MIN_CELL_SIZE 0.01f
+#define GRID_NO_CELL (-1) // overflow and removed bodies
+
+static uint32_t hash_cell(int cx, int cy) {
+    uint32_t hash = (uint32_t) cx * 73856093u ^ (uint32_t) cy * 19349663u;
+    hash = ((hash >> 16) ^ hash) * 0x45d9f3b;
+    return (hash >> 16) ^ hash;
+}
+
+static void float_swap(float* a, float* b) {
+    float temp = *a;
+    *a = *b;
+    *b = temp;
+}
+
+// quickselect, partially sorts the values so that values[k] is the k-th smallest
+static float float_select(float* values, int count, int k) {
+    int lo = 0;
+    int hi = count - 1;
+    while (lo < hi) {
+        float pivot = values[(lo + hi) / 2];
+        int i = lo;
+        int j = hi;
+        while (i <= j) {
+            while (values[i] < pivot)
+                i++;
+            while (values[j] > pivot)
+                j--;
+            if (i <= j) {
+                float_swap(&values[i], &values[j]);
+                i++;
+                j--;
+            }
+        }
+        if (k <= j)
+            hi = j;
+        else if (k >= i)
+            lo = i;
+        else
+            break;
+    }
+    return values[k];
+}
+
+static int grid_cell_coord(float min, float max, float inv_cell_size) {
+    float cell = floorf((min + max) * 0.5f * inv_cell_size);
+    return (int) cell;
+}
+
+static int grid_cell_of(float x, float inv_cell_size) {
+    float cell = floorf(x * inv_cell_size);
+    return (int) cell;
+}
+
+static float aabb_extent(AABB aabb) {
+    return fmaxf(aabb.max.x - aabb.min.x, aabb.max.y - aabb.min.y);
+}
+
+static void grid_pick_cell_size(SpatialGrid* grid, BodyArray bodies) {
+    grid->extents.count = 0;
+    for (uint32_t i = 0; i < grid->aabbs.count; i++) {
+        if (!bodies.items[i].removed)
+            DA_APPEND(&grid->extents, aabb_extent(grid->aabbs.items[i]));
+    }
+    if (grid->extents.count == 0)
+        return;
+    float median = float_select(grid->extents.items, grid->extents.count, grid->extents.count / 2);
+    grid->cell_size = fmaxf(median * GRID_CELL_SCALE, GRID_MIN_CELL_SIZE);
+    grid->sized_for_count = grid->aabbs.count;
+}
+
+static void grid_resize_table(SpatialGrid* grid, uint32_t num_bodies) {
+    uint32_t table_size = 16;
+    while (table_size < 2 * num_bodies)
+        table_size *= 2;
+    grid->table_mask = table_size - 1;
+    DA_RESERVE(&grid->cell_start, table_size + 1);
+    grid->cell_start.count = table_size + 1;
+}
+
+static bool grid_is_candidate(BodyArray bodies, AABBArray aabbs, int i, int j) {
+    if (bodies.items[j].removed)
+        return false;
+    if (body_is_static(&bodies.items[i]) && body_is_static(&bodies.items[j]))
+        return false;
+    return aabb_overlaps(aabbs.items[i], aabbs.items[j]);
+}
+
+void grid_init(SpatialGrid* grid) {
+    grid->cell_size = 0;
+    grid->max_extent = 0;
+    grid->max_motion = -1.0f;
+    grid->sized_for_count = 0;
+    grid->table_mask = 0;
+    grid->cell_start = (IntArray) DA_NULL;
+    grid->hashes = (IntArray) DA_NULL;
+    grid->entries = (GridEntryArray) DA_NULL;
+    grid->aabbs = (AABBArray) DA_NULL;
+    grid->overflow = (IntArray) DA_NULL;
+    grid->extents = (FloatArray) DA_NULL;
+}
+
+void grid_free(SpatialGrid* grid) {
+    DA_FREE(&grid->cell_start);
+    DA_FREE(&grid->hashes);
+    DA_FREE(&grid->entries);
+    DA_FREE(&grid->aabbs);
+    DA_FREE(&grid->overflow);
+    DA_FREE(&grid->extents);
+}
+
+void grid_update(SpatialGrid* grid, BodyArray bodies, PairArray* pairs) {
+    if (bodies.count == 0)
+        return;
+
+    grid->aabbs.count = 0;
+    for (uint32_t i = 0; i < bodies.count; i++) {
+        Body* body = &bodies.items[i];
+        AABB aabb = { body->position, body->position }; // removed bodies are skipped, their shape is gone
+        if (!body->removed)
+            aabb = body_compute_aabb(body);
+        DA_APPEND(&grid->aabbs, aabb);
+    }
+
+    // the cell size only depends on the bodies' sizes, pick it again when bodies are added
+    if (grid->sized_for_count != bodies.count) {
+        grid_pick_cell_size(grid, bodies);
+        grid_resize_table(grid, bodies.count);
+    }
+
+    // count the bodies in each bucket
+    float inv_cell_size = 1.0f / grid->cell_size;
+    int* cell_start = grid->cell_start.items;
+    for (uint32_t i = 0; i <= grid->table_mask + 1; i++) {
+        cell_start[i] = 0;
+    }
+    grid->hashes.count = 0;
+    grid->overflow.count = 0;
+    grid->max_extent = 0;
+    grid->max_motion = -1.0f;
+    for (uint32_t i = 0; i < bodies.count; i++) {
+        AABB aabb = grid->aabbs.items[i];
+        if (bodies.items[i].removed) {
+            DA_APPEND(&grid->hashes, GRID_NO_CELL);
+            continue;
+        }
+        float extent = aabb_extent(aabb);
+        if (extent > grid->cell_size) {
+            DA_APPEND(&grid->overflow, i);
+            DA_APPEND(&grid->hashes, GRID_NO_CELL);
+            continue;
+        }
+        grid->max_extent = fmaxf(grid->max_extent, extent);
+        int cx = grid_cell_coord(aabb.min.x, aabb.max.x, inv_cell_size);
+        int cy = grid_cell_coord(aabb.min.y, aabb.max.y, inv_cell_size);
+        int hash = hash_cell(cx, cy) & grid->table_mask;
+        DA_APPEND(&grid->hashes, hash);
+        cell_start[hash + 1]++;
+    }
+
+    // prefix sum and counting sort of the binned bodies by bucket
+    for (uint32_t i = 0; i <= grid->table_mask; i++) {
+        cell_start[i + 1] += cell_start[i];
+    }
+    uint32_t num_binned = cell_start[grid->table_mask + 1];
+    DA_RESERVE(&grid->entries, num_binned);
+    grid->entries.count = num_binned;
+    for (uint32_t i = 0; i < bodies.count; i++) {
+        int hash = grid->hashes.items[i];
+        if (hash < 0)
+            continue;
+        AABB aabb = grid->aabbs.items[i];
+        GridEntry* entry = &grid->entries.items[cell_start[hash]++];
+        entry->cx = grid_cell_coord(aabb.min.x, aabb.max.x, inv_cell_size);
+        entry->cy = grid_cell_coord(aabb.min.y, aabb.max.y, inv_cell_size);
+        entry->body_index = i;
+    }
+    // the placement loop moved every start to the end of its bucket, shift them back
+    for (uint32_t i = grid->table_mask + 1; i > 0; i--) {
+        cell_start[i] = cell_start[i - 1];
+    }
+    cell_start[0] = 0;
+
+    // binned bodies: look at the 3x3 neighbourhood of each body's cell
+    for (uint32_t e = 0; e < grid->entries.count; e++) {
+        GridEntry* entry = &grid->entries.items[e];
+        int i = entry->body_index;
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                int cx = entry->cx + dx;
+                int cy = entry->cy + dy;
+                uint32_t hash = hash_cell(cx, cy) & grid->table_mask;
+                for (int k = cell_start[hash]; k < cell_start[hash + 1]; k++) {
+                    GridEntry* other = &grid->entries.items[k];
+                    int j = other->body_index;
+                    // skip hash collisions and keep each pair only once
+                    if (other->cx != cx || other->cy != cy || j <= i)
+                        continue;
+                    if (grid_is_candidate(bodies, grid->aabbs, i, j))
+                        DA_APPEND(pairs, ((Pair){i, j}));
+                }
+            }
+        }
+    }
+
+    // overflow bodies are tested against all the others
+    for (uint32_t o = 0; o < grid->overflow.count; o++) {
+        int i = grid->overflow.items[o];
+        for (uint32_t j = 0; j < bodies.count; j++) {
+            bool other_is_overflow = grid->hashes.items[j] < 0;
+            if ((int) j == i || (other_is_overflow && (int) j < i))
+                continue;
+            if (grid_is_candidate(bodies, grid->aabbs, i, j)) {
+                Pair pair = i < (int) j ? (Pair){i, j} : (Pair){j, i};
+                DA_APPEND(pairs, pair);
+            }
+        }
+    }
+}
+
+static bool grid_query_body(BodyArray bodies, AABB aabb, int index, TreeQueryCallback callback, void* context) {
+    if (bodies.items[index].removed || !aabb_overlaps(aabb, body_compute_aabb(&bodies.items[index])))
+        return true;
+    return callback(context, index);
+}
+
+void grid_query(SpatialGrid* grid, BodyArray bodies, AABB aabb, TreeQueryCallback callback, void* context) {
+    // the bodies were binned by their center before the solver moved them: the margin covers the half extent
+    // from the center to the edge of a binned body (which a rotation can grow up to the full extent) and the
+    // largest move since then, found once per update
+    uint32_t num_binned = grid->entries.count;
+    if (grid->max_motion < 0.0f) {
+        grid->max_motion = 0.0f;
+        for (uint32_t e = 0; e < num_binned; e++) {
+            Body* body = &bodies.items[grid->entries.items[e].body_index];
+            float motion = vec2_magnitude(vec2_sub(body->position, body->prev_position));
+            grid->max_motion = fmaxf(grid->max_motion, motion);
+        }
+    }
+    if (num_binned > 0) {
+        float inv_cell_size = 1.0f / grid->cell_size;
+        float margin = grid->max_extent + grid->max_motion;
+        int min_cx = grid_cell_of(aabb.min.x - margin, inv_cell_size);
+        int min_cy = grid_cell_of(aabb.min.y - margin, inv_cell_size);
+        int max_cx = grid_cell_of(aabb.max.x + margin, inv_cell_size);
+        int max_cy = grid_cell_of(aabb.max.y + margin, inv_cell_size);
+        int64_t num_cells = ((int64_t) max_cx - min_cx + 1) * ((int64_t) max_cy - min_cy + 1);
+        if (num_cells > (int64_t) num_binned) {
+            // a long sweep covers more cells than there are bodies, going through the bodies is cheaper
+            for (uint32_t e = 0; e < num_binned; e++) {
+                GridEntry* entry = &grid->entries.items[e];
+                bool in_range = entry->cx >= min_cx && entry->cx <= max_cx && entry->cy >= min_cy && entry->cy <= max_cy;
+                if (in_range && !grid_query_body(bodies, aabb, entry->body_index, callback, context))
+                    return;
+            }
+        } else {
+            int* cell_start = grid->cell_start.items;
+            for (int cy = min_cy; cy <= max_cy; cy++) {
+                for (int cx = min_cx; cx <= max_cx; cx++) {
+                    uint32_t hash = hash_cell(cx, cy) & grid->table_mask;
+                    for (int k = cell_start[hash]; k < cell_start[hash + 1]; k++) {
+                        GridEntry* entry = &grid->entries.items[k];
+                        // skip hash collisions, so that each body is seen from its own cell only
+                        if (entry->cx != cx || entry->cy != cy)
+                            continue;
+                        if (!grid_query_body(bodies, aabb, entry->body_index, callback, context))
+                            return;
+                    }
+                }
+            }
+        }
+    }
+
+    for (uint32_t o = 0; o < grid->overflow.count; o++) {
+        if (!grid_query_body(bodies, aabb, grid->overflow.items[o], callback, context))
+            return;
+    }
+    // bodies added since the last update are not binned yet
+    for (uint32_t i = grid->hashes.count; i < bodies.count; i++) {
+        if (!grid_query_body(bodies, aabb, i, callback, context))
+            return;
+    }
+}
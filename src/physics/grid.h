@@ -0,0 +1,52 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include "aabb.h"
+#include "array.h"
+#include "body.h"
+#include "table.h"
+#include "tree.h"
+
+typedef struct {
+    int cx;
+    int cy;
+    int body_index;
+} GridEntry;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    GridEntry* items;
+} GridEntryArray;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    AABB* items;
+} AABBArray;
+
+// uniform spatial hash grid: each body is binned in the cell of its aabb center, so with a cell
+// size not smaller than the biggest binned body, overlapping bodies are always in neighbouring cells.
+// Bodies bigger than a cell (walls, containers) are kept in an overflow list and tested against everything
+typedef struct {
+    float cell_size;
+    float max_extent; // of the binned bodies at the last update, never more than the cell size
+    float max_motion; // largest move of a binned body since the last update, negative until a query needs it
+    uint32_t sized_for_count; // number of bodies when the cell size was picked
+    uint32_t table_mask;
+    IntArray cell_start; // start of each hash bucket in entries (prefix sum), table size + 1
+    IntArray hashes; // bucket of each binned body, -1 for overflow and removed bodies
+    GridEntryArray entries; // binned bodies sorted by bucket
+    AABBArray aabbs;
+    IntArray overflow;
+    FloatArray extents; // scratch buffer to find the median extent
+} SpatialGrid;
+
+void grid_init(SpatialGrid* grid);
+void grid_free(SpatialGrid* grid);
+void grid_update(SpatialGrid* grid, BodyArray bodies, PairArray* pairs);
+// calls back with the index of the bodies whose aabb overlaps the given one, until the callback returns false.
+// Only the cells around the aabb and the overflow bodies are looked at, with the bins of the last update
+void grid_query(SpatialGrid* grid, BodyArray bodies, AABB aabb, TreeQueryCallback callback, void* context);
+
+#endif // GRID_H
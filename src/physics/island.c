@@ -0,0 +1,266 @@
+#include "island.h"
+#include "array.h"
+#include "body.h"
+#include "world.h"
+#include <float.h>
+
+#define TIME_TO_SLEEP 0.5f // seconds
+
+static int island_find(IslandSet* islands, int i) {
+    int* parent = islands->parent.items;
+    while (parent[i] != i) {
+        // path halving
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+static void island_union(IslandSet* islands, int i, int j) {
+    int root_i = island_find(islands, i);
+    int root_j = island_find(islands, j);
+    if (root_i == root_j)
+        return;
+    // the smallest index is the root, so that islands are numbered in body order
+    if (root_i < root_j)
+        islands->parent.items[root_j] = root_i;
+    else
+        islands->parent.items[root_i] = root_j;
+}
+
+// a static body that moves anyway (hack for demo 4) keeps everything it touches awake
+static bool body_is_moving_static(Body* body) {
+    return body_is_static(body) && (body->angular_velocity != 0.0f || body->velocity.x != 0.0f || body->velocity.y != 0.0f);
+}
+
+static void island_link(IslandSet* islands, BodyArray bodies, int a_index, int b_index) {
+    Body* a = &bodies.items[a_index];
+    Body* b = &bodies.items[b_index];
+    bool a_is_static = body_is_static(a);
+    bool b_is_static = body_is_static(b);
+    if (!a_is_static && !b_is_static) {
+        island_union(islands, a_index, b_index);
+    } else if (a_is_static && !b_is_static && body_is_moving_static(a)) {
+        // temporarily mark the root, islands are numbered afterwards
+        islands->body_island.items[b_index] = -2;
+    } else if (b_is_static && !a_is_static && body_is_moving_static(b)) {
+        islands->body_island.items[a_index] = -2;
+    }
+}
+
+void island_init(IslandSet* islands) {
+    islands->parent = (IntArray) DA_NULL;
+    islands->body_island = (IntArray) DA_NULL;
+    islands->bodies = (IntArray) DA_NULL;
+    islands->joints = (IntArray) DA_NULL;
+    islands->manifolds = (IntArray) DA_NULL;
+    islands->scratch_island = (IntArray) DA_NULL;
+    islands->scratch_index = (IntArray) DA_NULL;
+    islands->islands = (IslandArray) DA_NULL;
+}
+
+void island_free(IslandSet* islands) {
+    DA_FREE(&islands->parent);
+    DA_FREE(&islands->body_island);
+    DA_FREE(&islands->bodies);
+    DA_FREE(&islands->joints);
+    DA_FREE(&islands->manifolds);
+    DA_FREE(&islands->scratch_island);
+    DA_FREE(&islands->scratch_index);
+    DA_FREE(&islands->islands);
+}
+
+void island_build(IslandSet* islands, World* world) {
+    BodyArray bodies = world->bodies;
+    DA_RESERVE(&islands->parent, bodies.count);
+    DA_RESERVE(&islands->body_island, bodies.count);
+    islands->parent.count = bodies.count;
+    islands->body_island.count = bodies.count;
+    for (uint32_t i = 0; i < bodies.count; i++) {
+        islands->parent.items[i] = i;
+        islands->body_island.items[i] = -1;
+    }
+
+    // joints and manifolds are the edges of the graph
+    for (uint32_t c = 0; c < world->joint_constraints.count; c++) {
+        JointConstraint* joint = &world->joint_constraints.items[c];
+        island_link(islands, bodies, joint->a_index, joint->b_index);
+    }
+    for (uint32_t c = 0; c < world->manifolds.count; c++) {
+        // skip the manifolds that were not refreshed by the narrow phase (they are about to be removed),
+        // unless they belong to sleeping bodies, whose manifolds are kept as they are
+        Manifold* manifold = &world->manifolds.items[c];
+        bool is_awake = body_is_awake(&bodies.items[manifold->a_index]) || body_is_awake(&bodies.items[manifold->b_index]);
+        if (!manifold->expired || !is_awake)
+            island_link(islands, bodies, manifold->a_index, manifold->b_index);
+    }
+
+    // number the islands in the order of their roots
+    islands->islands.count = 0;
+    for (uint32_t i = 0; i < bodies.count; i++) {
+        Body* body = &bodies.items[i];
+        if (body_is_static(body) || body->removed)
+            continue;
+        int root = island_find(islands, i);
+        if (root == (int) i) {
+            Island* island = DA_NEXT_PTR(&islands->islands);
+            island->body_start = 0;
+            island->body_count = 0;
+            island->joint_start = 0;
+            island->joint_count = 0;
+            island->manifold_start = 0;
+            island->manifold_count = 0;
+            island->min_sleep_time = FLT_MAX;
+            island->can_sleep = true;
+            island->sleeping = true;
+            island->has_sleeping_bodies = false;
+        }
+    }
+
+    // roots are the smallest index of their island, so they are visited before the
+    // other bodies and their island index is already known when the others look it up
+    int num_islands = 0;
+    for (uint32_t i = 0; i < bodies.count; i++) {
+        Body* body = &bodies.items[i];
+        if (body_is_static(body) || body->removed)
+            continue;
+        int root = island_find(islands, i);
+        int island_index;
+        if (root == (int) i) {
+            island_index = num_islands++;
+        } else {
+            island_index = islands->body_island.items[root];
+        }
+        Island* island = &islands->islands.items[island_index];
+        if (islands->body_island.items[i] == -2)
+            island->can_sleep = false;
+        islands->body_island.items[i] = island_index;
+        island->body_count++;
+        if (body->sleep_time < island->min_sleep_time)
+            island->min_sleep_time = body->sleep_time;
+        island->sleeping = island->sleeping && body->sleeping;
+        island->has_sleeping_bodies = island->has_sleeping_bodies || body->sleeping;
+    }
+
+    // group the bodies by island (counting sort)
+    uint32_t start = 0;
+    for (uint32_t k = 0; k < islands->islands.count; k++) {
+        Island* island = &islands->islands.items[k];
+        island->body_start = start;
+        start += island->body_count;
+        island->body_count = 0;
+    }
+    DA_RESERVE(&islands->bodies, start);
+    islands->bodies.count = start;
+    for (uint32_t i = 0; i < bodies.count; i++) {
+        int island_index = islands->body_island.items[i];
+        if (island_index < 0)
+            continue;
+        Island* island = &islands->islands.items[island_index];
+        islands->bodies.items[island->body_start + island->body_count++] = i;
+    }
+}
+
+void island_update_sleep(IslandSet* islands, World* world) {
+    for (uint32_t k = 0; k < islands->islands.count; k++) {
+        Island* island = &islands->islands.items[k];
+        bool should_sleep = world->allow_sleep && island->can_sleep && island->min_sleep_time >= TIME_TO_SLEEP;
+        if (should_sleep ? island->sleeping : !island->has_sleeping_bodies)
+            continue;
+
+        island->sleeping = should_sleep;
+        island->has_sleeping_bodies = should_sleep;
+        for (uint32_t b = 0; b < island->body_count; b++) {
+            Body* body = &world->bodies.items[islands->bodies.items[island->body_start + b]];
+            if (should_sleep) {
+                body_sleep(body);
+            } else if (body->sleeping) {
+                // an awake body touched the island
+                body_wake(body);
+            }
+        }
+    }
+}
+
+// island of a constraint between two bodies, -1 when none of them is awake (sleeping or static).
+// Constraints that are solved link their bodies, so both of them are in the same island
+static int island_of_pair(IslandSet* islands, BodyArray bodies, int a_index, int b_index) {
+    if (body_is_awake(&bodies.items[a_index]))
+        return islands->body_island.items[a_index];
+    if (body_is_awake(&bodies.items[b_index]))
+        return islands->body_island.items[b_index];
+    return -1;
+}
+
+static uint32_t* island_start(Island* island, bool manifolds) {
+    return manifolds ? &island->manifold_start : &island->joint_start;
+}
+
+static uint32_t* island_count(Island* island, bool manifolds) {
+    return manifolds ? &island->manifold_count : &island->joint_count;
+}
+
+// counting sort of the constraints in the scratch arrays by island, keeping their order
+static void island_group(IslandSet* islands, IntArray* out, bool manifolds) {
+    Island* items = islands->islands.items;
+    for (uint32_t k = 0; k < islands->islands.count; k++) {
+        *island_count(&items[k], manifolds) = 0;
+    }
+    for (uint32_t c = 0; c < islands->scratch_island.count; c++) {
+        (*island_count(&items[islands->scratch_island.items[c]], manifolds))++;
+    }
+    uint32_t start = 0;
+    for (uint32_t k = 0; k < islands->islands.count; k++) {
+        *island_start(&items[k], manifolds) = start;
+        start += *island_count(&items[k], manifolds);
+        *island_count(&items[k], manifolds) = 0;
+    }
+    DA_RESERVE(out, start);
+    out->count = start;
+    for (uint32_t c = 0; c < islands->scratch_island.count; c++) {
+        Island* island = &items[islands->scratch_island.items[c]];
+        uint32_t* count = island_count(island, manifolds);
+        out->items[*island_start(island, manifolds) + (*count)++] = islands->scratch_index.items[c];
+    }
+}
+
+uint32_t island_collect_constraints(IslandSet* islands, World* world) {
+    BodyArray bodies = world->bodies;
+
+    // joints of the awake islands
+    islands->scratch_island.count = 0;
+    islands->scratch_index.count = 0;
+    for (uint32_t c = 0; c < world->joint_constraints.count; c++) {
+        JointConstraint* joint = &world->joint_constraints.items[c];
+        int island_index = island_of_pair(islands, bodies, joint->a_index, joint->b_index);
+        if (island_index < 0)
+            continue;
+        DA_APPEND(&islands->scratch_island, island_index);
+        DA_APPEND(&islands->scratch_index, c);
+    }
+    island_group(islands, &islands->joints, false);
+
+    // live manifolds of the awake islands
+    islands->scratch_island.count = 0;
+    islands->scratch_index.count = 0;
+    uint32_t num_expired = 0;
+    for (uint32_t c = 0; c < world->manifolds.count; c++) {
+        Manifold* manifold = &world->manifolds.items[c];
+        int island_index = island_of_pair(islands, bodies, manifold->a_index, manifold->b_index);
+        if (island_index < 0) {
+            // sleeping manifolds are kept as they are until the bodies wake up
+            manifold->expired = true;
+        } else if (manifold->expired) {
+            // the last manifold, not visited yet, is moved here
+            world_remove_manifold(world, c--);
+            num_expired++;
+        } else {
+            // solved this step, then it expires unless the narrow phase refreshes it
+            manifold->expired = true;
+            DA_APPEND(&islands->scratch_island, island_index);
+            DA_APPEND(&islands->scratch_index, c);
+        }
+    }
+    island_group(islands, &islands->manifolds, true);
+    return num_expired;
+}
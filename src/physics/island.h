@@ -0,0 +1,52 @@
+#ifndef ISLAND_H
+#define ISLAND_H
+
+#include "array.h"
+#include <stdbool.h>
+
+// an island is a set of non static bodies connected by contacts or joints.
+// Static bodies don't propagate islands, they can touch any number of them
+typedef struct {
+    uint32_t body_start; // first body of the island in IslandSet.bodies
+    uint32_t body_count;
+    uint32_t joint_start; // first joint of the island in IslandSet.joints
+    uint32_t joint_count;
+    uint32_t manifold_start; // first manifold of the island in IslandSet.manifolds
+    uint32_t manifold_count;
+    float min_sleep_time;
+    bool can_sleep; // false when touching a moving static body (e.g. the motor of demo 4)
+    bool sleeping; // all the bodies are sleeping
+    bool has_sleeping_bodies;
+} Island;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    Island* items;
+} IslandArray;
+
+typedef struct {
+    IntArray parent; // union-find forest over the world's bodies
+    IntArray body_island; // island of each body, -1 for static bodies
+    IntArray bodies; // body indices grouped by island
+    IntArray joints; // joint indices grouped by island
+    IntArray manifolds; // indices in World.manifolds grouped by island
+    IntArray scratch_island;
+    IntArray scratch_index;
+    IslandArray islands;
+} IslandSet;
+
+struct World;
+
+void island_init(IslandSet* islands);
+void island_free(IslandSet* islands);
+// build the islands from the joints and the live manifolds
+void island_build(IslandSet* islands, struct World* world);
+// put to sleep the islands that have been still for long enough, wake up the others
+void island_update_sleep(IslandSet* islands, struct World* world);
+// group the joints and the manifolds of the awake islands, keeping their order in the world.
+// Manifolds that were not refreshed by the narrow phase are removed from the table here,
+// the others are marked as expired until the next narrow phase refreshes them. Returns the manifolds removed
+uint32_t island_collect_constraints(IslandSet* islands, struct World* world);
+
+#endif // ISLAND_H
@@ -3,6 +3,8 @@
 #include "vec2.h"
 
 void manifold_init(Manifold* manifold, int num_contacts, int a_index, int b_index) {
+    // the slot can hold a removed manifold, whose impulses would leak into the warm start of a contact added later
+    *manifold = (Manifold) { 0 };
     manifold->a_index = a_index;
     manifold->b_index = b_index;
     manifold->num_contacts = num_contacts;
@@ -26,21 +28,46 @@ bool manifold_find_existing_contact(Manifold* manifold, Contact* contact) {
     return false;
 }
 
-void manifold_pre_solve(Manifold* manifold, BodyArray world_bodies, float dt) {
+void manifold_pre_solve(Manifold* manifold, BodyArray world_bodies, SolverBodyArray* solver_bodies, float dt) {
     for (int i = 0; i < manifold->num_contacts; i++) {
         PenetrationConstraint* constraint = &manifold->constraints[i];
         Body* a = &world_bodies.items[manifold->a_index];
         Body* b = &world_bodies.items[manifold->b_index];
-        constraint_penetration_pre_solve(constraint, a, b, dt);
+        constraint_penetration_pre_solve(constraint, a, b, solver_bodies, manifold->a_index, manifold->b_index, dt);
     }
 }
 
-void manifold_solve(Manifold* manifold, BodyArray world_bodies) {
+void manifold_solve(Manifold* manifold, SolverBodyArray* solver_bodies) {
     for (int i = 0; i < manifold->num_contacts; i++) {
         PenetrationConstraint* constraint = &manifold->constraints[i];
-        Body* a = &world_bodies.items[manifold->a_index];
-        Body* b = &world_bodies.items[manifold->b_index];
-        constraint_penetration_solve(constraint, a, b);
+        constraint_penetration_solve(constraint, solver_bodies, manifold->a_index, manifold->b_index);
+    }
+}
+
+
+void manifold_prepare(Manifold* manifold, BodyArray world_bodies, SolverBodyArray* solver_bodies) {
+    Body* a = &world_bodies.items[manifold->a_index];
+    Body* b = &world_bodies.items[manifold->b_index];
+    for (int i = 0; i < manifold->num_contacts; i++) {
+        constraint_penetration_prepare(&manifold->constraints[i], a, b, solver_bodies, manifold->a_index, manifold->b_index);
+    }
+}
+
+void manifold_warm_start(Manifold* manifold, SolverBodyArray* solver_bodies) {
+    for (int i = 0; i < manifold->num_contacts; i++) {
+        constraint_penetration_warm_start(&manifold->constraints[i], solver_bodies, manifold->a_index, manifold->b_index);
     }
 }
 
+void manifold_solve_soft(Manifold* manifold, SolverBodyArray* solver_bodies, Softness* softness, float inv_h, bool use_bias) {
+    for (int i = 0; i < manifold->num_contacts; i++) {
+        constraint_penetration_solve_soft(&manifold->constraints[i], solver_bodies, manifold->a_index, manifold->b_index,
+            softness, inv_h, use_bias);
+    }
+}
+
+void manifold_restitution(Manifold* manifold, SolverBodyArray* solver_bodies) {
+    for (int i = 0; i < manifold->num_contacts; i++) {
+        constraint_penetration_restitution(&manifold->constraints[i], solver_bodies, manifold->a_index, manifold->b_index);
+    }
+}
@@ -3,6 +3,7 @@
 
 #include "constraint.h"
 #include "collision.h"
+#include "solver.h"
 
 #define MAX_CONTACTS 2
 
@@ -24,7 +25,12 @@ struct World;
 
 void manifold_init(Manifold* manifold, int num_contacts, int a_index, int b_index);
 bool manifold_find_existing_contact(Manifold* manifold, Contact* contact);
-void manifold_pre_solve(Manifold* manifold, BodyArray world_bodies, float dt);
-void manifold_solve(Manifold* manifold, BodyArray world_bodies);
+void manifold_pre_solve(Manifold* manifold, BodyArray world_bodies, SolverBodyArray* solver_bodies, float dt);
+void manifold_solve(Manifold* manifold, SolverBodyArray* solver_bodies);
+// substep solver, see constraint.h
+void manifold_prepare(Manifold* manifold, BodyArray world_bodies, SolverBodyArray* solver_bodies);
+void manifold_warm_start(Manifold* manifold, SolverBodyArray* solver_bodies);
+void manifold_solve_soft(Manifold* manifold, SolverBodyArray* solver_bodies, Softness* softness, float inv_h, bool use_bias);
+void manifold_restitution(Manifold* manifold, SolverBodyArray* solver_bodies);
 
 #endif // MANIFOLD_H
@@ -0,0 +1,483 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "recorder.h"
+#include "array.h"
+#include "body.h"
+#include "world.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORDER_CHUNK_MAGIC 0x4b4e4843 // "CHNK"
+#define RECORDER_INDEX_MAGIC 0x58444e49 // "INDX"
+#define RECORDER_KEYFRAME_BODY_SIZE (1 + RECORDER_NUM_VALUES * sizeof(float)) // removed flag and exact values
+#define RECORDER_MAX_VARINT_SIZE 10
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t keyframe_interval;
+    float steps[RECORDER_NUM_VALUES];
+} RecorderHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t first_step;
+    uint32_t num_steps;
+    uint32_t num_bodies;
+    uint32_t size; // bytes of frames after the header
+} RecorderChunkHeader;
+
+// at the end of the file, once the recorder is closed
+typedef struct {
+    uint64_t index_offset;
+    uint32_t num_chunks;
+    uint32_t magic;
+} RecorderFooter;
+
+static const float recorder_steps[RECORDER_NUM_VALUES] = {
+    RECORDER_POSITION_STEP,
+    RECORDER_POSITION_STEP,
+    RECORDER_ROTATION_STEP,
+    RECORDER_VELOCITY_STEP,
+    RECORDER_VELOCITY_STEP,
+    RECORDER_ANGULAR_VELOCITY_STEP,
+};
+
+static void recorder_get_values(RecordedBody* body, float* values) {
+    values[0] = body->position.x;
+    values[1] = body->position.y;
+    values[2] = body->rotation;
+    values[3] = body->velocity.x;
+    values[4] = body->velocity.y;
+    values[5] = body->angular_velocity;
+}
+
+static void recorder_set_values(RecordedBody* body, float* values) {
+    body->position = VEC2(values[0], values[1]);
+    body->rotation = values[2];
+    body->velocity = VEC2(values[3], values[4]);
+    body->angular_velocity = values[5];
+}
+
+#define RECORDER_MAX_QUANTIZED 4e18 // fits in an int64_t
+
+static int64_t recorder_quantize(float value, float step) {
+    if (!isfinite(value))
+        return 0;
+    double quantized = (double) value / (double) step;
+    quantized = fmax(fmin(quantized, RECORDER_MAX_QUANTIZED), -RECORDER_MAX_QUANTIZED);
+    return (int64_t) llrint(quantized);
+}
+
+static float recorder_dequantize(int64_t value, float step) {
+    return (float) ((double) value * (double) step);
+}
+
+// room for extra bytes at the end, growing like DA_APPEND
+static uint8_t* recorder_grow(ByteArray* bytes, uint32_t extra) {
+    uint32_t needed = bytes->count + extra;
+    if (needed > bytes->capacity) {
+        uint32_t capacity = bytes->capacity == 0 ? START_CAPACITY : bytes->capacity;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        DA_RESERVE(bytes, capacity);
+    }
+    return bytes->items + bytes->count;
+}
+
+// zigzag, so that small negative numbers are small too, then 7 bits per byte
+static uint8_t* recorder_put_varint(uint8_t* out, int64_t value) {
+    uint64_t bits = ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+    while (bits >= 0x80) {
+        *out++ = (uint8_t) (bits | 0x80);
+        bits >>= 7;
+    }
+    *out++ = (uint8_t) bits;
+    return out;
+}
+
+// NULL if the varint goes past the end
+static const uint8_t* recorder_get_varint(const uint8_t* in, const uint8_t* end, int64_t* value) {
+    uint64_t bits = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (in == end)
+            return NULL;
+        uint8_t byte = *in++;
+        bits |= (uint64_t) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = (int64_t) (bits >> 1) ^ -(int64_t) (bits & 1);
+            return in;
+        }
+    }
+    return NULL;
+}
+
+static bool recorder_write(Recorder* recorder, const void* data, size_t size) {
+    if (size > 0 && fwrite(data, size, 1, recorder->file) != 1)
+        recorder->failed = true;
+    recorder->offset += size;
+    return !recorder->failed;
+}
+
+// the chunk is kept in memory until it is complete, so a recording cut short loses at most one chunk
+static void recorder_end_chunk(Recorder* recorder) {
+    if (recorder->chunk_num_steps == 0)
+        return;
+    RecorderChunkHeader header = {
+        .magic = RECORDER_CHUNK_MAGIC,
+        .first_step = recorder->chunk_first_step,
+        .num_steps = recorder->chunk_num_steps,
+        .num_bodies = recorder->chunk_num_bodies,
+        .size = recorder->chunk.count,
+    };
+    RecorderChunkInfo info = { .offset = recorder->offset, .first_step = header.first_step, .num_steps = header.num_steps };
+    DA_APPEND(&recorder->chunks, info);
+    recorder_write(recorder, &header, sizeof(header));
+    recorder_write(recorder, recorder->chunk.items, recorder->chunk.count);
+    fflush(recorder->file);
+    recorder->chunk.count = 0;
+    recorder->chunk_num_steps = 0;
+}
+
+static void recorder_encode_keyframe(Recorder* recorder, RecorderFrame* frame) {
+    uint32_t num_bodies = frame->bodies.count;
+    DA_RESERVE(&recorder->quantized, num_bodies * RECORDER_NUM_VALUES);
+    DA_RESERVE(&recorder->values, num_bodies * RECORDER_NUM_VALUES);
+    DA_RESERVE(&recorder->removed, num_bodies);
+    uint8_t* out = recorder_grow(&recorder->chunk, num_bodies * RECORDER_KEYFRAME_BODY_SIZE);
+    for (uint32_t i = 0; i < num_bodies; i++) {
+        RecordedBody* body = &frame->bodies.items[i];
+        float values[RECORDER_NUM_VALUES];
+        recorder_get_values(body, values);
+        *out++ = body->removed;
+        memcpy(out, values, sizeof(values));
+        out += sizeof(values);
+        memcpy(&recorder->values.items[i * RECORDER_NUM_VALUES], values, sizeof(values));
+        recorder->removed.items[i] = body->removed;
+        for (int v = 0; v < RECORDER_NUM_VALUES; v++) {
+            recorder->quantized.items[i * RECORDER_NUM_VALUES + v] = recorder_quantize(values[v], recorder_steps[v]);
+        }
+    }
+    recorder->chunk.count = (uint32_t) (out - recorder->chunk.items);
+}
+
+// a bit per body telling if it moved, then the changes of the ones that did. A body that moved less than a
+// quantization step is written too (with zero changes), so that the reader replaces its exact keyframe values
+static void recorder_encode_delta(Recorder* recorder, RecorderFrame* frame) {
+    uint32_t num_bodies = frame->bodies.count;
+    uint32_t mask_size = (num_bodies + 7) / 8;
+    uint8_t* mask = recorder_grow(&recorder->chunk, mask_size + num_bodies * RECORDER_NUM_VALUES * RECORDER_MAX_VARINT_SIZE);
+    memset(mask, 0, mask_size);
+    uint8_t* out = mask + mask_size;
+    for (uint32_t i = 0; i < num_bodies; i++) {
+        float values[RECORDER_NUM_VALUES];
+        recorder_get_values(&frame->bodies.items[i], values);
+        float* previous_values = &recorder->values.items[i * RECORDER_NUM_VALUES];
+        if (memcmp(values, previous_values, sizeof(values)) == 0)
+            continue;
+        memcpy(previous_values, values, sizeof(values));
+        int64_t* previous = &recorder->quantized.items[i * RECORDER_NUM_VALUES];
+        int64_t deltas[RECORDER_NUM_VALUES];
+        for (int v = 0; v < RECORDER_NUM_VALUES; v++) {
+            int64_t quantized = recorder_quantize(values[v], recorder_steps[v]);
+            deltas[v] = quantized - previous[v];
+            previous[v] = quantized;
+        }
+        mask[i / 8] |= (uint8_t) (1 << (i % 8));
+        for (int v = 0; v < RECORDER_NUM_VALUES; v++) {
+            out = recorder_put_varint(out, deltas[v]);
+        }
+    }
+    recorder->chunk.count = (uint32_t) (out - recorder->chunk.items);
+}
+
+// a chunk also ends when bodies are added or removed, so that its frames all have the same bodies
+static bool recorder_needs_keyframe(Recorder* recorder, RecorderFrame* frame) {
+    if (recorder->chunk_num_steps == 0 || recorder->chunk_num_steps >= recorder->keyframe_interval)
+        return true;
+    if (frame->bodies.count != recorder->chunk_num_bodies)
+        return true;
+    for (uint32_t i = 0; i < frame->bodies.count; i++) {
+        if (frame->bodies.items[i].removed != recorder->removed.items[i])
+            return true;
+    }
+    return false;
+}
+
+static void recorder_encode(Recorder* recorder, RecorderFrame* frame) {
+    if (recorder_needs_keyframe(recorder, frame)) {
+        recorder_end_chunk(recorder);
+        recorder->chunk_first_step = frame->step;
+        recorder->chunk_num_bodies = frame->bodies.count;
+        recorder_encode_keyframe(recorder, frame);
+    } else {
+        recorder_encode_delta(recorder, frame);
+    }
+    recorder->chunk_num_steps++;
+}
+
+static void* recorder_thread(void* arg) {
+    Recorder* recorder = arg;
+    for (;;) {
+        pthread_mutex_lock(&recorder->mutex);
+        while (recorder->queue_count == 0 && !recorder->quit) {
+            pthread_cond_wait(&recorder->frame_cond, &recorder->mutex);
+        }
+        if (recorder->queue_count == 0) {
+            pthread_mutex_unlock(&recorder->mutex);
+            break;
+        }
+        RecorderFrame* frame = &recorder->queue[recorder->queue_head];
+        pthread_mutex_unlock(&recorder->mutex);
+
+        // the capture doesn't touch the frame until it is given back
+        recorder_encode(recorder, frame);
+
+        pthread_mutex_lock(&recorder->mutex);
+        recorder->queue_head = (recorder->queue_head + 1) % RECORDER_QUEUE_SIZE;
+        recorder->queue_count--;
+        pthread_cond_signal(&recorder->free_cond);
+        pthread_mutex_unlock(&recorder->mutex);
+    }
+    return NULL;
+}
+
+bool recorder_open(Recorder* recorder, const char* path, uint32_t keyframe_interval) {
+    *recorder = (Recorder) { 0 };
+    recorder->file = fopen(path, "wb");
+    if (recorder->file == NULL) {
+        printf("ERROR: can't create the recording %s.\n", path);
+        return false;
+    }
+    recorder->keyframe_interval = keyframe_interval > 0 ? keyframe_interval : 1;
+    RecorderHeader header = { .magic = RECORDER_MAGIC, .version = RECORDER_VERSION, .keyframe_interval = recorder->keyframe_interval };
+    memcpy(header.steps, recorder_steps, sizeof(header.steps));
+    recorder_write(recorder, &header, sizeof(header));
+
+    pthread_mutex_init(&recorder->mutex, NULL);
+    pthread_cond_init(&recorder->frame_cond, NULL);
+    pthread_cond_init(&recorder->free_cond, NULL);
+    if (pthread_create(&recorder->thread, NULL, recorder_thread, recorder) != 0) {
+        printf("ERROR: can't create the recorder thread, aborting.\n");
+        exit(1);
+    }
+    return true;
+}
+
+void recorder_capture(Recorder* recorder, World* world) {
+    pthread_mutex_lock(&recorder->mutex);
+    while (recorder->queue_count == RECORDER_QUEUE_SIZE) {
+        pthread_cond_wait(&recorder->free_cond, &recorder->mutex);
+    }
+    RecorderFrame* frame = &recorder->queue[(recorder->queue_head + recorder->queue_count) % RECORDER_QUEUE_SIZE];
+    pthread_mutex_unlock(&recorder->mutex);
+
+    // the frame is not in the queue yet, so the encoding thread doesn't read it
+    DA_RESERVE(&frame->bodies, world->bodies.count);
+    frame->bodies.count = world->bodies.count;
+    frame->step = recorder->num_captured++;
+    for (uint32_t i = 0; i < world->bodies.count; i++) {
+        Body* body = &world->bodies.items[i];
+        frame->bodies.items[i] = (RecordedBody) {
+            .position = body->position,
+            .rotation = body->rotation,
+            .velocity = body->velocity,
+            .angular_velocity = body->angular_velocity,
+            .removed = body->removed,
+        };
+    }
+
+    pthread_mutex_lock(&recorder->mutex);
+    recorder->queue_count++;
+    pthread_cond_signal(&recorder->frame_cond);
+    pthread_mutex_unlock(&recorder->mutex);
+}
+
+bool recorder_close(Recorder* recorder) {
+    pthread_mutex_lock(&recorder->mutex);
+    recorder->quit = true;
+    pthread_cond_signal(&recorder->frame_cond);
+    pthread_mutex_unlock(&recorder->mutex);
+    pthread_join(recorder->thread, NULL);
+
+    recorder_end_chunk(recorder);
+    RecorderFooter footer = { .index_offset = recorder->offset, .num_chunks = recorder->chunks.count, .magic = RECORDER_INDEX_MAGIC };
+    recorder_write(recorder, recorder->chunks.items, recorder->chunks.count * sizeof(RecorderChunkInfo));
+    recorder_write(recorder, &footer, sizeof(footer));
+    bool ok = fclose(recorder->file) == 0 && !recorder->failed;
+    if (!ok)
+        printf("ERROR: the recording could not be written completely.\n");
+
+    pthread_mutex_destroy(&recorder->mutex);
+    pthread_cond_destroy(&recorder->frame_cond);
+    pthread_cond_destroy(&recorder->free_cond);
+    for (int f = 0; f < RECORDER_QUEUE_SIZE; f++) {
+        DA_FREE(&recorder->queue[f].bodies);
+    }
+    DA_FREE(&recorder->chunk);
+    DA_FREE(&recorder->quantized);
+    DA_FREE(&recorder->values);
+    DA_FREE(&recorder->removed);
+    DA_FREE(&recorder->chunks);
+    return ok;
+}
+
+static bool recorder_read_at(FILE* file, uint64_t offset, void* data, size_t size) {
+    return fseeko(file, (off_t) offset, SEEK_SET) == 0 && (size == 0 || fread(data, size, 1, file) == 1);
+}
+
+static bool recorder_reader_read_index(RecorderReader* reader) {
+    RecorderFooter footer;
+    if (fseeko(reader->file, -(off_t) sizeof(footer), SEEK_END) != 0 || fread(&footer, sizeof(footer), 1, reader->file) != 1)
+        return false;
+    if (footer.magic != RECORDER_INDEX_MAGIC)
+        return false;
+    DA_RESERVE(&reader->chunks, footer.num_chunks);
+    reader->chunks.count = footer.num_chunks;
+    return recorder_read_at(reader->file, footer.index_offset, reader->chunks.items, footer.num_chunks * sizeof(RecorderChunkInfo));
+}
+
+// without an index the chunks are found by walking their headers
+static void recorder_reader_scan_chunks(RecorderReader* reader) {
+    reader->chunks.count = 0;
+    if (fseeko(reader->file, 0, SEEK_END) != 0)
+        return;
+    uint64_t size = (uint64_t) ftello(reader->file);
+    uint64_t offset = sizeof(RecorderHeader);
+    RecorderChunkHeader header;
+    while (offset + sizeof(header) <= size && recorder_read_at(reader->file, offset, &header, sizeof(header))) {
+        uint64_t next = offset + sizeof(header) + header.size;
+        if (header.magic != RECORDER_CHUNK_MAGIC || next > size)
+            break;
+        RecorderChunkInfo info = { .offset = offset, .first_step = header.first_step, .num_steps = header.num_steps };
+        DA_APPEND(&reader->chunks, info);
+        offset = next;
+    }
+}
+
+bool recorder_reader_open(RecorderReader* reader, const char* path) {
+    *reader = (RecorderReader) { .current_chunk = -1 };
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL) {
+        printf("ERROR: can't open the recording %s.\n", path);
+        return false;
+    }
+    RecorderHeader header;
+    if (fread(&header, sizeof(header), 1, reader->file) != 1 || header.magic != RECORDER_MAGIC || header.version != RECORDER_VERSION) {
+        printf("ERROR: %s is not a recording of version %d.\n", path, RECORDER_VERSION);
+        fclose(reader->file);
+        return false;
+    }
+    reader->keyframe_interval = header.keyframe_interval;
+    memcpy(reader->steps, header.steps, sizeof(reader->steps));
+    if (!recorder_reader_read_index(reader))
+        recorder_reader_scan_chunks(reader);
+    if (reader->chunks.count > 0) {
+        RecorderChunkInfo* last = &reader->chunks.items[reader->chunks.count - 1];
+        reader->num_steps = last->first_step + last->num_steps;
+    }
+    return true;
+}
+
+void recorder_reader_close(RecorderReader* reader) {
+    fclose(reader->file);
+    DA_FREE(&reader->chunks);
+    DA_FREE(&reader->chunk_data);
+    DA_FREE(&reader->quantized);
+    DA_FREE(&reader->bodies);
+}
+
+static bool recorder_reader_load_chunk(RecorderReader* reader, int chunk) {
+    RecorderChunkHeader header;
+    RecorderChunkInfo* info = &reader->chunks.items[chunk];
+    if (!recorder_read_at(reader->file, info->offset, &header, sizeof(header)) || header.magic != RECORDER_CHUNK_MAGIC)
+        return false;
+    DA_RESERVE(&reader->chunk_data, header.size);
+    reader->chunk_data.count = header.size;
+    if (!recorder_read_at(reader->file, info->offset + sizeof(header), reader->chunk_data.items, header.size))
+        return false;
+    if ((uint64_t) header.num_bodies * RECORDER_KEYFRAME_BODY_SIZE > header.size)
+        return false;
+
+    uint32_t num_bodies = header.num_bodies;
+    DA_RESERVE(&reader->bodies, num_bodies);
+    DA_RESERVE(&reader->quantized, num_bodies * RECORDER_NUM_VALUES);
+    reader->bodies.count = num_bodies;
+    const uint8_t* in = reader->chunk_data.items;
+    for (uint32_t i = 0; i < num_bodies; i++) {
+        float values[RECORDER_NUM_VALUES];
+        RecordedBody* body = &reader->bodies.items[i];
+        body->removed = *in++ != 0;
+        memcpy(values, in, sizeof(values));
+        in += sizeof(values);
+        recorder_set_values(body, values);
+        for (int v = 0; v < RECORDER_NUM_VALUES; v++) {
+            reader->quantized.items[i * RECORDER_NUM_VALUES + v] = recorder_quantize(values[v], reader->steps[v]);
+        }
+    }
+    reader->current_chunk = chunk;
+    reader->current_step = info->first_step;
+    reader->cursor = (uint32_t) (in - reader->chunk_data.items);
+    return true;
+}
+
+static bool recorder_reader_decode_delta(RecorderReader* reader) {
+    uint32_t num_bodies = reader->bodies.count;
+    uint32_t mask_size = (num_bodies + 7) / 8;
+    const uint8_t* mask = reader->chunk_data.items + reader->cursor;
+    const uint8_t* end = reader->chunk_data.items + reader->chunk_data.count;
+    if (mask_size > (uint32_t) (end - mask))
+        return false;
+    const uint8_t* in = mask + mask_size;
+    for (uint32_t i = 0; i < num_bodies; i++) {
+        if ((mask[i / 8] & (1 << (i % 8))) == 0)
+            continue;
+        int64_t* quantized = &reader->quantized.items[i * RECORDER_NUM_VALUES];
+        float values[RECORDER_NUM_VALUES];
+        for (int v = 0; v < RECORDER_NUM_VALUES; v++) {
+            int64_t delta;
+            in = recorder_get_varint(in, end, &delta);
+            if (in == NULL)
+                return false;
+            quantized[v] += delta;
+            values[v] = recorder_dequantize(quantized[v], reader->steps[v]);
+        }
+        recorder_set_values(&reader->bodies.items[i], values);
+    }
+    reader->cursor = (uint32_t) (in - reader->chunk_data.items);
+    reader->current_step++;
+    return true;
+}
+
+bool recorder_reader_seek(RecorderReader* reader, uint32_t step) {
+    if (step >= reader->num_steps)
+        return false;
+    // last chunk that starts at or before the step
+    int low = 0;
+    int high = (int) reader->chunks.count - 1;
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (reader->chunks.items[mid].first_step <= step)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+    RecorderChunkInfo* info = &reader->chunks.items[low];
+    if (step >= info->first_step + info->num_steps)
+        return false;
+    if (low != reader->current_chunk || step < reader->current_step) {
+        if (!recorder_reader_load_chunk(reader, low)) {
+            reader->current_chunk = -1;
+            return false;
+        }
+    }
+    while (reader->current_step < step) {
+        if (!recorder_reader_decode_delta(reader)) {
+            reader->current_chunk = -1;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,126 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "array.h"
+#include "vec2.h"
+#include "world.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// recording of the motion of every body slot, one frame per world_update. The file is a header followed by
+// chunks and an index of the chunks. A chunk starts with a keyframe (the exact floats), the other frames of
+// the chunk store the quantized change of the bodies that moved since the previous frame as varints. A body
+// that didn't move at all keeps its exact values, the others are off by at most half a quantization step
+#define RECORDER_MAGIC 0x52443250 // "P2DR"
+#define RECORDER_VERSION 1
+#define RECORDER_QUEUE_SIZE 4 // captured frames waiting to be encoded, a capture waits when they are all taken
+
+#define RECORDER_NUM_VALUES 6 // recorded per body: x, y, rotation, vx, vy, angular velocity
+
+// quantization steps of the frames between keyframes
+#define RECORDER_POSITION_STEP 0.0001f // 0.1 mm
+#define RECORDER_ROTATION_STEP 0.0001f
+#define RECORDER_VELOCITY_STEP 0.001f
+#define RECORDER_ANGULAR_VELOCITY_STEP 0.001f
+
+typedef struct {
+    Vec2 position;
+    float rotation;
+    Vec2 velocity;
+    float angular_velocity;
+    bool removed;
+} RecordedBody;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    RecordedBody* items;
+} RecordedBodyArray;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    uint8_t* items;
+} ByteArray;
+
+typedef struct {
+    uint64_t offset; // of the chunk header in the file
+    uint32_t first_step;
+    uint32_t num_steps;
+} RecorderChunkInfo;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    RecorderChunkInfo* items;
+} RecorderChunkInfoArray;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    int64_t* items;
+} QuantizedArray;
+
+typedef struct {
+    RecordedBodyArray bodies;
+    uint32_t step;
+} RecorderFrame;
+
+typedef struct {
+    FILE* file;
+    uint32_t keyframe_interval; // frames per chunk
+    uint32_t num_captured;
+    // frames handed from the capture to the encoding thread
+    RecorderFrame queue[RECORDER_QUEUE_SIZE];
+    uint32_t queue_head; // next frame to encode
+    uint32_t queue_count;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t frame_cond; // a frame was captured, or the recorder is closing
+    pthread_cond_t free_cond; // a frame was encoded
+    bool quit;
+    // only used by the encoding thread
+    bool failed; // a write failed, the recording is incomplete
+    ByteArray chunk; // encoded frames of the current chunk
+    uint32_t chunk_first_step;
+    uint32_t chunk_num_steps;
+    uint32_t chunk_num_bodies;
+    QuantizedArray quantized; // of the previous frame, RECORDER_NUM_VALUES per body
+    FloatArray values; // exact values of the previous frame
+    ByteArray removed; // of the previous frame
+    RecorderChunkInfoArray chunks;
+    uint64_t offset; // where the next chunk goes
+} Recorder;
+
+typedef struct {
+    FILE* file;
+    uint32_t keyframe_interval;
+    float steps[RECORDER_NUM_VALUES]; // quantization of each value, from the file
+    uint32_t num_steps; // frames in the recording
+    RecorderChunkInfoArray chunks;
+    // the decoded frame
+    int current_chunk; // -1 before the first seek
+    uint32_t current_step;
+    uint32_t cursor; // in chunk_data, start of the next frame
+    ByteArray chunk_data;
+    QuantizedArray quantized;
+    RecordedBodyArray bodies; // state of the body slots at current_step
+} RecorderReader;
+
+// starts the encoding thread, false if the file can't be created
+bool recorder_open(Recorder* recorder, const char* path, uint32_t keyframe_interval);
+// call it after world_update: copies the state of the bodies for the encoding thread, which does the rest
+void recorder_capture(Recorder* recorder, World* world);
+// encodes the frames that are left and writes the index. False if something could not be written
+bool recorder_close(Recorder* recorder);
+
+// a recording whose index is missing (the program stopped without closing it) is read up to its last whole chunk
+bool recorder_reader_open(RecorderReader* reader, const char* path);
+void recorder_reader_close(RecorderReader* reader);
+// decodes the frame of a step (counted from the first capture) into reader->bodies. Moving forward inside a
+// chunk only decodes the frames in between, anything else starts from the keyframe of the chunk of the step
+bool recorder_reader_seek(RecorderReader* reader, uint32_t step);
+
+#endif // RECORDER_H
@@ -0,0 +1,396 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "scene.h"
+#include "array.h"
+#include "body.h"
+#include "constraint.h"
+#include "shape.h"
+#include "table.h"
+#include "world.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    SceneShape* items;
+} SceneShapeArray;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    SceneMaterial* items;
+} SceneMaterialArray;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    SceneBody* items;
+} SceneBodyArray;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    SceneJoint* items;
+} SceneJointArray;
+
+typedef struct {
+    SceneShapeArray shapes;
+    Vec2Array vertices;
+    SceneMaterialArray materials;
+    SceneBodyArray bodies;
+    SceneJointArray joints;
+    Table shape_map; // hash of a shape -> its index in shapes
+    Table material_map; // bits of the restitution and the friction -> index in materials
+} SceneWriter;
+
+static const uint32_t scene_record_sizes[SCENE_SECTION_COUNT] = {
+    [SCENE_SHAPES] = sizeof(SceneShape),
+    [SCENE_VERTICES] = sizeof(Vec2),
+    [SCENE_MATERIALS] = sizeof(SceneMaterial),
+    [SCENE_BODIES] = sizeof(SceneBody),
+    [SCENE_JOINTS] = sizeof(SceneJoint),
+};
+
+static uint32_t scene_float_bits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// fnv-1a, a word at a time
+static uint32_t scene_hash(uint32_t hash, uint32_t value) {
+    return (hash ^ value) * 16777619u;
+}
+
+// the vertices of a box are rebuilt from its size, only the other polygons store them
+static SceneShape scene_shape_from(Shape* shape, Vec2** vertices) {
+    SceneShape record = { .type = shape->type };
+    *vertices = NULL;
+    switch (shape->type) {
+        case SHAPE_CIRCLE:
+        case SHAPE_CIRCLE_CONTAINER:
+            record.radius = shape->as.circle.radius;
+            break;
+        case SHAPE_BOX:
+            record.width = shape->as.box.width;
+            record.height = shape->as.box.height;
+            break;
+        case SHAPE_POLYGON:
+            record.vertex_count = shape->as.polygon.count;
+            *vertices = shape->as.polygon.local_vertices;
+            break;
+    }
+    return record;
+}
+
+// same record and vertices, except where the vertices are
+static bool scene_shape_equals(SceneWriter* writer, uint32_t index, SceneShape* record, Vec2* vertices) {
+    SceneShape* other = &writer->shapes.items[index];
+    SceneShape candidate = *record;
+    candidate.first_vertex = other->first_vertex;
+    if (memcmp(&candidate, other, sizeof(candidate)) != 0)
+        return false;
+    return record->vertex_count == 0
+        || memcmp(vertices, &writer->vertices.items[other->first_vertex], record->vertex_count * sizeof(Vec2)) == 0;
+}
+
+static uint32_t scene_add_shape(SceneWriter* writer, Shape* shape) {
+    Vec2* vertices;
+    SceneShape record = scene_shape_from(shape, &vertices);
+    uint32_t hash = 2166136261u;
+    hash = scene_hash(hash, scene_float_bits(record.radius));
+    hash = scene_hash(hash, scene_float_bits(record.width));
+    hash = scene_hash(hash, scene_float_bits(record.height));
+    for (uint32_t i = 0; i < record.vertex_count; i++) {
+        hash = scene_hash(hash, scene_float_bits(vertices[i].x));
+        hash = scene_hash(hash, scene_float_bits(vertices[i].y));
+    }
+    Pair key = { .i = hash, .j = record.type | record.vertex_count << 8 };
+
+    bool found = false;
+    uint32_t index = *ht_get_or_new(&writer->shape_map, key, writer->shapes.count, &found);
+    // a different shape with the same hash is just stored again
+    if (found && scene_shape_equals(writer, index, &record, vertices))
+        return index;
+    record.first_vertex = writer->vertices.count;
+    for (uint32_t i = 0; i < record.vertex_count; i++) {
+        DA_APPEND(&writer->vertices, vertices[i]);
+    }
+    DA_APPEND(&writer->shapes, record);
+    return writer->shapes.count - 1;
+}
+
+static uint32_t scene_add_material(SceneWriter* writer, Body* body) {
+    Pair key = { .i = scene_float_bits(body->restitution), .j = scene_float_bits(body->friction) };
+    bool found = false;
+    uint32_t index = *ht_get_or_new(&writer->material_map, key, writer->materials.count, &found);
+    if (!found)
+        DA_APPEND(&writer->materials, ((SceneMaterial) { .restitution = body->restitution, .friction = body->friction }));
+    return index;
+}
+
+static bool scene_write_section(FILE* file, void* items, uint32_t count, uint32_t record_size) {
+    return count == 0 || fwrite(items, record_size, count, file) == count;
+}
+
+bool scene_save(World* world, const char* path) {
+    SceneWriter writer = {
+        .shapes = DA_NULL,
+        .vertices = DA_NULL,
+        .materials = DA_NULL,
+        .bodies = DA_NULL,
+        .joints = DA_NULL,
+    };
+    ht_init(&writer.shape_map, 16, 70);
+    ht_init(&writer.material_map, 16, 70);
+
+    // removed bodies are skipped, so the joints need the new index of each body
+    IntArray body_index = DA_NULL;
+    DA_RESERVE(&body_index, world->bodies.count);
+    DA_RESERVE(&writer.bodies, world->bodies.count);
+    for (uint32_t i = 0; i < world->bodies.count; i++) {
+        Body* body = &world->bodies.items[i];
+        if (body->removed) {
+            body_index.items[i] = -1;
+            continue;
+        }
+        body_index.items[i] = (int) writer.bodies.count;
+        SceneBody record = {
+            .shape = scene_add_shape(&writer, &body->shape),
+            .material = scene_add_material(&writer, body),
+            .position = body->position,
+            .rotation = body->rotation,
+            .velocity = body->velocity,
+            .angular_velocity = body->angular_velocity,
+            .inv_mass = body->inv_mass,
+            .inv_I = body->inv_I,
+            .flags = body->bullet ? SCENE_BODY_BULLET : 0,
+        };
+        DA_APPEND(&writer.bodies, record);
+    }
+    for (uint32_t c = 0; c < world->joint_constraints.count; c++) {
+        JointConstraint* joint = &world->joint_constraints.items[c];
+        int a_index = body_index.items[joint->a_index];
+        int b_index = body_index.items[joint->b_index];
+        if (a_index < 0 || b_index < 0)
+            continue;
+        SceneJoint record = {
+            .a_index = (uint32_t) a_index,
+            .b_index = (uint32_t) b_index,
+            .a_point = joint->a_point,
+            .b_point = joint->b_point,
+        };
+        DA_APPEND(&writer.joints, record);
+    }
+
+    SceneHeader header = {
+        .magic = SCENE_MAGIC,
+        .version = SCENE_VERSION,
+        .num_manifolds = world->manifolds.count,
+    };
+    void* items[SCENE_SECTION_COUNT] = {
+        [SCENE_SHAPES] = writer.shapes.items,
+        [SCENE_VERTICES] = writer.vertices.items,
+        [SCENE_MATERIALS] = writer.materials.items,
+        [SCENE_BODIES] = writer.bodies.items,
+        [SCENE_JOINTS] = writer.joints.items,
+    };
+    uint32_t counts[SCENE_SECTION_COUNT] = {
+        [SCENE_SHAPES] = writer.shapes.count,
+        [SCENE_VERTICES] = writer.vertices.count,
+        [SCENE_MATERIALS] = writer.materials.count,
+        [SCENE_BODIES] = writer.bodies.count,
+        [SCENE_JOINTS] = writer.joints.count,
+    };
+    // all the records are made of 4 byte fields, so the sections follow each other without padding
+    uint32_t offset = sizeof(header);
+    for (int s = 0; s < SCENE_SECTION_COUNT; s++) {
+        header.sections[s] = (SceneSection) { .offset = offset, .count = counts[s], .record_size = scene_record_sizes[s] };
+        offset += counts[s] * scene_record_sizes[s];
+    }
+
+    bool ok = false;
+    FILE* file = fopen(path, "wb");
+    if (file != NULL) {
+        ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        for (int s = 0; s < SCENE_SECTION_COUNT && ok; s++) {
+            ok = scene_write_section(file, items[s], counts[s], scene_record_sizes[s]);
+        }
+        ok = fclose(file) == 0 && ok;
+    }
+    if (!ok)
+        printf("ERROR: can't write the scene %s.\n", path);
+
+    DA_FREE(&body_index);
+    DA_FREE(&writer.shapes);
+    DA_FREE(&writer.vertices);
+    DA_FREE(&writer.materials);
+    DA_FREE(&writer.bodies);
+    DA_FREE(&writer.joints);
+    ht_free(&writer.shape_map);
+    ht_free(&writer.material_map);
+    return ok;
+}
+
+static bool scene_check_header(SceneHeader* header, size_t size) {
+    if (header->magic != SCENE_MAGIC || header->version != SCENE_VERSION)
+        return false;
+    for (int s = 0; s < SCENE_SECTION_COUNT; s++) {
+        SceneSection* section = &header->sections[s];
+        if (section->record_size != scene_record_sizes[s] || section->offset % 4 != 0)
+            return false;
+        if ((uint64_t) section->offset + (uint64_t) section->count * section->record_size > size)
+            return false;
+    }
+    return true;
+}
+
+// builds the shape of every shape record once, the bodies copy it
+static bool scene_build_shapes(const uint8_t* data, SceneHeader* header, Shape* shapes) {
+    const SceneShape* records = (const SceneShape*) (data + header->sections[SCENE_SHAPES].offset);
+    const Vec2* vertices = (const Vec2*) (data + header->sections[SCENE_VERTICES].offset);
+    uint32_t num_vertices = header->sections[SCENE_VERTICES].count;
+    for (uint32_t i = 0; i < header->sections[SCENE_SHAPES].count; i++) {
+        const SceneShape* record = &records[i];
+        switch (record->type) {
+            case SHAPE_CIRCLE:
+                shape_init_circle(&shapes[i], record->radius);
+                break;
+            case SHAPE_CIRCLE_CONTAINER:
+                shape_init_circle_container(&shapes[i], record->radius);
+                break;
+            case SHAPE_BOX:
+                shape_init_box(&shapes[i], record->width, record->height);
+                break;
+            case SHAPE_POLYGON: {
+                if (record->vertex_count < 3 || record->vertex_count > SHAPE_MAX_VERTICES
+                        || (uint64_t) record->first_vertex + record->vertex_count > num_vertices)
+                    return false;
+                Vec2 local_vertices[SHAPE_MAX_VERTICES];
+                memcpy(local_vertices, &vertices[record->first_vertex], record->vertex_count * sizeof(Vec2));
+                Vec2Array array = { .capacity = record->vertex_count, .count = record->vertex_count, .items = local_vertices };
+                shape_init_polygon(&shapes[i], array);
+            } break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+static bool scene_check_indices(const uint8_t* data, SceneHeader* header) {
+    const SceneBody* bodies = (const SceneBody*) (data + header->sections[SCENE_BODIES].offset);
+    const SceneJoint* joints = (const SceneJoint*) (data + header->sections[SCENE_JOINTS].offset);
+    uint32_t num_bodies = header->sections[SCENE_BODIES].count;
+    for (uint32_t i = 0; i < num_bodies; i++) {
+        if (bodies[i].shape >= header->sections[SCENE_SHAPES].count
+                || bodies[i].material >= header->sections[SCENE_MATERIALS].count)
+            return false;
+    }
+    for (uint32_t i = 0; i < header->sections[SCENE_JOINTS].count; i++) {
+        if (joints[i].a_index >= num_bodies || joints[i].b_index >= num_bodies)
+            return false;
+    }
+    return true;
+}
+
+// everything is checked before the world is touched
+static bool scene_build(World* world, const uint8_t* data, size_t size) {
+    SceneHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (!scene_check_header(&header, size) || !scene_check_indices(data, &header))
+        return false;
+    uint32_t num_shapes = header.sections[SCENE_SHAPES].count;
+    Shape* shapes = malloc(num_shapes * sizeof(Shape));
+    if (shapes == NULL && num_shapes > 0) {
+        printf("ERROR: out of memory, aborting.\n");
+        exit(1);
+    }
+    if (!scene_build_shapes(data, &header, shapes)) {
+        free(shapes);
+        return false;
+    }
+
+    const SceneMaterial* materials = (const SceneMaterial*) (data + header.sections[SCENE_MATERIALS].offset);
+    const SceneBody* records = (const SceneBody*) (data + header.sections[SCENE_BODIES].offset);
+    const SceneJoint* joints = (const SceneJoint*) (data + header.sections[SCENE_JOINTS].offset);
+    uint32_t num_bodies = header.sections[SCENE_BODIES].count;
+    uint32_t num_joints = header.sections[SCENE_JOINTS].count;
+    world_reserve(world, world->bodies.count + num_bodies, world->manifolds.count + header.num_manifolds);
+    DA_RESERVE(&world->joint_constraints, world->joint_constraints.count + num_joints);
+
+    // a world that had removed bodies reuses their slots
+    IntArray body_index = DA_NULL;
+    DA_RESERVE(&body_index, num_bodies);
+    for (uint32_t i = 0; i < num_bodies; i++) {
+        const SceneBody* record = &records[i];
+        Body* body = world_new_body(world);
+        body_index.items[i] = (int) (body - world->bodies.items);
+        *body = (Body) {
+            .position = record->position,
+            .prev_position = record->position,
+            .velocity = record->velocity,
+            .rotation = record->rotation,
+            .prev_rotation = record->rotation,
+            .rot = rotation_from_angle(record->rotation),
+            .angular_velocity = record->angular_velocity,
+            .inv_mass = record->inv_mass,
+            .inv_I = record->inv_I,
+            .restitution = materials[record->material].restitution,
+            .friction = materials[record->material].friction,
+            .bullet = (record->flags & SCENE_BODY_BULLET) != 0,
+        };
+        Shape* shape = &shapes[record->shape];
+        body->shape.type = shape->type;
+        if (shape->type == SHAPE_POLYGON || shape->type == SHAPE_BOX) {
+            body->shape.as = shape->as;
+            shape_update_vertices(&body->shape, body->rot, body->position);
+            shape_sync_prev_vertices(&body->shape);
+        } else {
+            body->shape.as.circle = shape->as.circle;
+        }
+    }
+    for (uint32_t i = 0; i < num_joints; i++) {
+        *world_new_joint(world) = (JointConstraint) {
+            .a_index = body_index.items[joints[i].a_index],
+            .b_index = body_index.items[joints[i].b_index],
+            .a_point = joints[i].a_point,
+            .b_point = joints[i].b_point,
+        };
+    }
+    DA_FREE(&body_index);
+    free(shapes);
+    return true;
+}
+
+bool scene_load(World* world, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("ERROR: can't open the scene %s.\n", path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(SceneHeader)) {
+        printf("ERROR: %s is not a scene.\n", path);
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t) st.st_size;
+    void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping stays valid
+    if (data == MAP_FAILED) {
+        printf("ERROR: can't map the scene %s.\n", path);
+        return false;
+    }
+    bool ok = scene_build(world, data, size);
+    if (!ok)
+        printf("ERROR: %s is not a valid scene of version %d.\n", path, SCENE_VERSION);
+    munmap(data, size);
+    return ok;
+}
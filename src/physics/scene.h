@@ -0,0 +1,82 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "vec2.h"
+#include "world.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// binary scene file: a header followed by flat sections of fixed size records, little endian.
+// Bodies refer to their shape and material by index, so the many bodies of a level that share them
+// store them once, and the polygon shapes refer to a range of the vertices section
+#define SCENE_MAGIC 0x53443250 // "P2DS"
+#define SCENE_VERSION 1
+
+typedef enum {
+    SCENE_SHAPES,
+    SCENE_VERTICES,
+    SCENE_MATERIALS,
+    SCENE_BODIES,
+    SCENE_JOINTS,
+    SCENE_SECTION_COUNT
+} SceneSectionType;
+
+typedef struct {
+    uint32_t offset; // bytes from the start of the file, a multiple of 4
+    uint32_t count;
+    uint32_t record_size; // checked against the records of this version
+} SceneSection;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_manifolds; // live manifolds when the scene was saved, to presize the manifolds of the world
+    uint32_t reserved;
+    SceneSection sections[SCENE_SECTION_COUNT];
+} SceneHeader;
+
+typedef struct {
+    uint32_t type; // ShapeType
+    float radius; // circles and containers
+    float width; // boxes
+    float height;
+    uint32_t first_vertex; // polygons
+    uint32_t vertex_count;
+} SceneShape;
+
+typedef struct {
+    float restitution;
+    float friction;
+} SceneMaterial;
+
+#define SCENE_BODY_BULLET 1
+
+typedef struct {
+    uint32_t shape;
+    uint32_t material;
+    Vec2 position;
+    float rotation;
+    Vec2 velocity;
+    float angular_velocity;
+    // stored instead of the mass, so that a saved world loads back exactly the same
+    float inv_mass;
+    float inv_I;
+    uint32_t flags;
+} SceneBody;
+
+typedef struct {
+    uint32_t a_index; // in the bodies section
+    uint32_t b_index;
+    Vec2 a_point; // anchor in the local space of each body
+    Vec2 b_point;
+} SceneJoint;
+
+// writes the bodies and the joints of the world, without the removed bodies. Forces, static torques and
+// sleep are not saved. Returns false if the file can't be written
+bool scene_save(World* world, const char* path);
+// maps the file and adds its bodies and joints to the world, whose arrays are presized for them (so the bodies
+// that were already there can move). Returns false, leaving the world untouched, if the file can't be read
+// or is not a valid scene
+bool scene_load(World* world, const char* path);
+
+#endif // SCENE_H
@@ -1,7 +1,13 @@
 #include "shape.h"
-#include "array.h"
 #include <float.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 void shape_init_circle(Shape* shape, float radius) {
     shape->type = SHAPE_CIRCLE;
@@ -13,21 +19,29 @@ void shape_init_circle_container(Shape* shape, float radius) {
     shape->as.circle = (CircleShape) { .radius = radius };
 }
 
-void shape_init_polygon(Shape* shape, Vec2Array local_vertices) {
-    Vec2Array world_vertices = DA_NULL;
-    Vec2Array prev_world_vertices = DA_NULL;
-
-    for (uint32_t i = 0; i < local_vertices.count; i++) {
-        DA_APPEND(&world_vertices, local_vertices.items[i]);
-        DA_APPEND(&prev_world_vertices, local_vertices.items[i]);
+static void shape_polygon_init_normals(PolygonShape* polygon) {
+    for (uint32_t i = 0; i < polygon->count; i++) {
+        Vec2 edge = vec2_sub(polygon->local_vertices[(i + 1) % polygon->count], polygon->local_vertices[i]);
+        polygon->local_normals[i] = vec2_normal(edge);
+        polygon->world_normals[i] = polygon->local_normals[i];
     }
+}
 
+void shape_init_polygon(Shape* shape, Vec2Array local_vertices) {
+    if (local_vertices.count > SHAPE_MAX_VERTICES) {
+        printf("ERROR: polygons can't have more than %d vertices, aborting.\n", SHAPE_MAX_VERTICES);
+        exit(1);
+    }
     shape->type = SHAPE_POLYGON;
-    shape->as.polygon = (PolygonShape) {
-        .local_vertices = local_vertices,
-        .world_vertices = world_vertices,
-        .prev_world_vertices = prev_world_vertices
-    };
+    PolygonShape* polygon = &shape->as.polygon;
+    memset(polygon, 0, sizeof(*polygon)); // the vertices are transformed in pairs, an odd count reads one past the last
+    polygon->count = local_vertices.count;
+    for (uint32_t i = 0; i < local_vertices.count; i++) {
+        polygon->local_vertices[i] = local_vertices.items[i];
+        polygon->world_vertices[i] = local_vertices.items[i];
+        polygon->prev_world_vertices[i] = local_vertices.items[i];
+    }
+    shape_polygon_init_normals(polygon);
 }
 
 void shape_init_box(Shape* shape, float width, float height) {
@@ -36,34 +50,21 @@ void shape_init_box(Shape* shape, float width, float height) {
 
     // create vertices in local space (wrt the origin)
     // note: implemented like this is more of a local screen space because y-axis points down
-    Vec2Array local_vertices = DA_NULL;
-    DA_APPEND(&local_vertices, VEC2(-half_width, -half_height));
-    DA_APPEND(&local_vertices, VEC2(half_width, -half_height));
-    DA_APPEND(&local_vertices, VEC2(half_width, half_height));
-    DA_APPEND(&local_vertices, VEC2(-half_width, half_height));
-
-    Vec2Array world_vertices = DA_NULL;
-    DA_APPEND(&world_vertices, VEC2(-half_width, -half_height));
-    DA_APPEND(&world_vertices, VEC2(half_width, -half_height));
-    DA_APPEND(&world_vertices, VEC2(half_width, half_height));
-    DA_APPEND(&world_vertices, VEC2(-half_width, half_height));
-
-    Vec2Array prev_world_vertices = DA_NULL;
-    DA_APPEND(&prev_world_vertices, VEC2(-half_width, -half_height));
-    DA_APPEND(&prev_world_vertices, VEC2(half_width, -half_height));
-    DA_APPEND(&prev_world_vertices, VEC2(half_width, half_height));
-    DA_APPEND(&prev_world_vertices, VEC2(-half_width, half_height));
-
     shape->type = SHAPE_BOX;
-    shape->as.box = (BoxShape) {
-        .polygon = (PolygonShape) { 
-            .local_vertices = local_vertices,
-            .world_vertices = world_vertices,
-            .prev_world_vertices = prev_world_vertices
-        },
-        .width = width,
-        .height = height
-    };
+    PolygonShape* polygon = &shape->as.box.polygon;
+    memset(polygon, 0, sizeof(*polygon));
+    polygon->count = 4;
+    polygon->local_vertices[0] = VEC2(-half_width, -half_height);
+    polygon->local_vertices[1] = VEC2(half_width, -half_height);
+    polygon->local_vertices[2] = VEC2(half_width, half_height);
+    polygon->local_vertices[3] = VEC2(-half_width, half_height);
+    for (uint32_t i = 0; i < polygon->count; i++) {
+        polygon->world_vertices[i] = polygon->local_vertices[i];
+        polygon->prev_world_vertices[i] = polygon->local_vertices[i];
+    }
+    shape_polygon_init_normals(polygon);
+    shape->as.box.width = width;
+    shape->as.box.height = height;
 }
 
 float shape_moment_of_inertia(Shape* shape) {
@@ -89,50 +90,93 @@ float shape_moment_of_inertia(Shape* shape) {
     return 0;
 }
 
-void shape_update_vertices(Shape* shape, float angle, Vec2 position) {
+void shape_update_vertices(Shape* shape, Rotation rotation, Vec2 position) {
     bool is_circle = shape->type == SHAPE_CIRCLE || shape->type == SHAPE_CIRCLE_CONTAINER;
     if (is_circle)
         return;
     PolygonShape* polygon_shape = &shape->as.polygon;
+    memcpy(polygon_shape->prev_world_vertices, polygon_shape->world_vertices, polygon_shape->count * sizeof(Vec2));
+#if defined(__SSE2__)
+    // two vertices per register, as x0 y0 x1 y1: x' = x * c - y * s, y' = y * c + x * s
+    __m128 c = _mm_set1_ps(rotation.c);
+    __m128 s = _mm_set_ps(rotation.s, -rotation.s, rotation.s, -rotation.s);
+    __m128 p = _mm_set_ps(position.y, position.x, position.y, position.x);
+    for (uint32_t i = 0; i < polygon_shape->count; i += 2) {
+        __m128 v = _mm_loadu_ps(&polygon_shape->local_vertices[i].x);
+        __m128 v_swapped = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        __m128 rotated = _mm_add_ps(_mm_mul_ps(v, c), _mm_mul_ps(v_swapped, s));
+        _mm_storeu_ps(&polygon_shape->world_vertices[i].x, _mm_add_ps(rotated, p));
+
+        __m128 n = _mm_loadu_ps(&polygon_shape->local_normals[i].x);
+        __m128 n_swapped = _mm_shuffle_ps(n, n, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_ps(&polygon_shape->world_normals[i].x, _mm_add_ps(_mm_mul_ps(n, c), _mm_mul_ps(n_swapped, s)));
+    }
+#else
     // loop over all vertices and transform from local to world space
-    for (uint32_t i = 0; i < polygon_shape->local_vertices.count; i++) {
-        polygon_shape->prev_world_vertices.items[i] = polygon_shape->world_vertices.items[i];
+    for (uint32_t i = 0; i < polygon_shape->count; i++) {
         // first rotate, then translate
-        polygon_shape->world_vertices.items[i] = vec2_rotate(polygon_shape->local_vertices.items[i], angle);
-        polygon_shape->world_vertices.items[i] = vec2_add(polygon_shape->world_vertices.items[i], position);
+        polygon_shape->world_vertices[i] = vec2_rotate_by(polygon_shape->local_vertices[i], rotation);
+        polygon_shape->world_vertices[i] = vec2_add(polygon_shape->world_vertices[i], position);
+        polygon_shape->world_normals[i] = vec2_rotate_by(polygon_shape->local_normals[i], rotation);
     }
+#endif
+}
+
+void shape_sync_prev_vertices(Shape* shape) {
+    bool is_circle = shape->type == SHAPE_CIRCLE || shape->type == SHAPE_CIRCLE_CONTAINER;
+    if (is_circle)
+        return;
+    PolygonShape* polygon_shape = &shape->as.polygon;
+    memcpy(polygon_shape->prev_world_vertices, polygon_shape->world_vertices, polygon_shape->count * sizeof(Vec2));
 }
 
 Vec2 shape_polygon_edge_at(PolygonShape* shape, int index) {
-    int num_vertices = shape->world_vertices.count;
+    int num_vertices = shape->count;
     return vec2_sub(
-                shape->world_vertices.items[(index + 1) % num_vertices],
-                shape->world_vertices.items[index]
+                shape->world_vertices[(index + 1) % num_vertices],
+                shape->world_vertices[index]
             );
 }
 
-float shape_polygon_find_min_separation(PolygonShape* a, PolygonShape* b, int* index_reference_edge) {
+// walks from start to the vertex with the lowest projection on the direction. On a convex polygon the
+// projections only go down and then up again, so going downhill from any vertex ends at the lowest one
+static uint32_t shape_polygon_find_support_vertex(PolygonShape* polygon, Vec2 direction, uint32_t start) {
+    uint32_t current = start;
+    float current_proj = vec2_dot(polygon->world_vertices[current], direction);
+    uint32_t step = 1;
+    uint32_t next = (current + step) % polygon->count;
+    float next_proj = vec2_dot(polygon->world_vertices[next], direction);
+    if (next_proj >= current_proj) {
+        // downhill is the other way, or start is already the lowest
+        step = polygon->count - 1;
+        next = (current + step) % polygon->count;
+        next_proj = vec2_dot(polygon->world_vertices[next], direction);
+    }
+    for (uint32_t i = 0; i < polygon->count && next_proj < current_proj; i++) {
+        current = next;
+        current_proj = next_proj;
+        next = (current + step) % polygon->count;
+        next_proj = vec2_dot(polygon->world_vertices[next], direction);
+    }
+    return current;
+}
+
+float shape_polygon_find_min_separation(PolygonShape* a, PolygonShape* b, int* index_reference_edge, int* index_support_vertex) {
     float separation = -FLT_MAX; // -inf
 
-    for (uint32_t i = 0; i < a->world_vertices.count; i++) {
-        Vec2 va = a->world_vertices.items[i];
-        Vec2 edge = shape_polygon_edge_at(a, i);
-        Vec2 normal = vec2_normal(edge);
-
-        float min_separation = FLT_MAX;
-        /*Vec2 min_vertex;*/
-        for (uint32_t j = 0; j < b->world_vertices.count; j++) {
-            Vec2 vb = b->world_vertices.items[j];
-            Vec2 va_vb = vec2_sub(vb, va); // vector from va to vb
-            float proj = vec2_dot(va_vb, normal);
-            if (proj < min_separation) {
-                min_separation = proj;
-                /*min_vertex = vb;*/
-            }
-        }
+    // the normals of a turn around in order, so the vertex of b behind each edge is only a few steps away
+    // from the one of the previous edge and the whole search costs about as many steps as both have vertices
+    uint32_t support = 0;
+    for (uint32_t i = 0; i < a->count; i++) {
+        Vec2 va = a->world_vertices[i];
+        Vec2 normal = a->world_normals[i];
+
+        support = shape_polygon_find_support_vertex(b, normal, support);
+        float min_separation = vec2_dot(vec2_sub(b->world_vertices[support], va), normal);
         if (min_separation > separation) {
             separation = min_separation;
             *index_reference_edge = i;
+            *index_support_vertex = support;
         }
 
         if (separation > 0) {
@@ -144,28 +188,21 @@ float shape_polygon_find_min_separation(PolygonShape* a, PolygonShape* b, int* i
     return separation;
 }
 
-int shape_polygon_find_incident_edge_index(PolygonShape* reference, Vec2 normal) {
-    float min_proj = FLT_MAX;
-    int incident_edge = -1;
-    for (uint32_t i = 0; i < reference->world_vertices.count; i++) {
-        Vec2 edge = shape_polygon_edge_at(reference, i);
-        Vec2 edge_normal = vec2_normal(edge);
-
-        float proj = vec2_dot(edge_normal, normal);
-        if (proj < min_proj) {
-            min_proj = proj;
-            incident_edge = i;
-        }
-    }
-    return incident_edge;
+int shape_polygon_find_incident_edge_index(PolygonShape* incident, Vec2 normal, int support_vertex) {
+    // the edge most opposite to the normal is one of the two that meet at the vertex farthest behind it
+    int prev_edge = (support_vertex + (int) incident->count - 1) % (int) incident->count;
+    float prev_proj = vec2_dot(incident->world_normals[prev_edge], normal);
+    float proj = vec2_dot(incident->world_normals[support_vertex], normal);
+    if (prev_proj < proj || (prev_proj == proj && prev_edge < support_vertex))
+        return prev_edge;
+    return support_vertex;
 }
 
-int shape_polygon_clip_segment_to_line(Vec2* contacts_in, Vec2* contacts_out, Vec2 c0, Vec2 c1) {
+int shape_polygon_clip_segment_to_line(Vec2* contacts_in, Vec2* contacts_out, Vec2 c0, Vec2 normal) {
     int num_out = 0;
 
-    Vec2 normal = vec2_normalize(vec2_sub(c1, c0));
-    float dist0 = vec2_cross(vec2_sub(contacts_in[0], c0), normal);
-    float dist1 = vec2_cross(vec2_sub(contacts_in[1], c0), normal);
+    float dist0 = vec2_dot(vec2_sub(contacts_in[0], c0), normal);
+    float dist1 = vec2_dot(vec2_sub(contacts_in[1], c0), normal);
 
     // if points are behind the plane
     if (dist0 <= 0)
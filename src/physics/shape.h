@@ -14,10 +14,23 @@ typedef struct {
     float radius;
 } CircleShape;
 
+// the vertices are stored in the shape, so a body needs no allocation and its vertices are next to the rest of it.
+// Scenes with rounder polygons can raise it when building (-DSHAPE_MAX_VERTICES=64), every body pays for the space
+#ifndef SHAPE_MAX_VERTICES
+#define SHAPE_MAX_VERTICES 8 // even, the vertices are transformed in pairs
+#endif
+#if SHAPE_MAX_VERTICES % 2 != 0
+#error "SHAPE_MAX_VERTICES must be even, the vertices are transformed in pairs"
+#endif
+
 typedef struct {
-    Vec2Array local_vertices;
-    Vec2Array world_vertices;
-    Vec2Array prev_world_vertices;
+    uint32_t count;
+    Vec2 local_vertices[SHAPE_MAX_VERTICES];
+    Vec2 world_vertices[SHAPE_MAX_VERTICES];
+    Vec2 prev_world_vertices[SHAPE_MAX_VERTICES];
+    // unit outward normal of the edge that starts at each vertex, rotated with the vertices
+    Vec2 local_normals[SHAPE_MAX_VERTICES];
+    Vec2 world_normals[SHAPE_MAX_VERTICES];
 } PolygonShape;
 
 typedef struct {
@@ -37,12 +50,15 @@ typedef struct {
 
 void shape_init_circle(Shape* shape, float radius);
 void shape_init_circle_container(Shape* shape, float radius);
+// the vertices are copied, there can be up to SHAPE_MAX_VERTICES of them
 void shape_init_polygon(Shape* shape, Vec2Array local_vertices);
 void shape_init_box(Shape* shape, float width, float height);
 float shape_moment_of_inertia(Shape* shape);
 
-// rotate and translate shape vertices from "local space" to "world space"
-void shape_update_vertices(Shape* shape, float angle, Vec2 position);
+// rotate and translate shape vertices from "local space" to "world space", the normals are only rotated
+void shape_update_vertices(Shape* shape, Rotation rotation, Vec2 position);
+// the shape stopped moving, the previous vertices used by the render interpolation catch up with the current ones
+void shape_sync_prev_vertices(Shape* shape);
 
 // Find edge at a certain vertex index.
 // Ex. triangle with vertices A, B, C
@@ -50,8 +66,11 @@ void shape_update_vertices(Shape* shape, float angle, Vec2 position);
 // index = 1 -> Edge BC
 // index = 2 -> Edge CA
 Vec2 shape_polygon_edge_at(PolygonShape* shape, int index);
-float shape_polygon_find_min_separation(PolygonShape* a, PolygonShape* b, int* index_reference_edge);
-int shape_polygon_find_incident_edge_index(PolygonShape* reference, Vec2 normal);
-int shape_polygon_clip_segment_to_line(Vec2* contacts_in, Vec2* contacts_out, Vec2 c0, Vec2 c1);
+// the deepest edge of a against b, and the vertex of b that is the farthest behind it
+float shape_polygon_find_min_separation(PolygonShape* a, PolygonShape* b, int* index_reference_edge, int* index_support_vertex);
+// support_vertex is the vertex of the incident polygon that is the farthest behind the reference edge
+int shape_polygon_find_incident_edge_index(PolygonShape* incident, Vec2 normal, int support_vertex);
+// keeps the part of the segment behind the line through c0 with the given outward normal
+int shape_polygon_clip_segment_to_line(Vec2* contacts_in, Vec2* contacts_out, Vec2 c0, Vec2 normal);
 
 #endif // SHAPE_H
@@ -0,0 +1,94 @@
+#include "solver.h"
+#include "body.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static float* solver_realloc(float* items, uint32_t capacity) {
+    items = realloc(items, capacity * sizeof *items);
+    if (items == NULL) {
+        printf("ERROR: out of memory, aborting.\n");
+        exit(1);
+    }
+    return items;
+}
+
+void solver_bodies_free(SolverBodyArray* bodies) {
+    free(bodies->vx);
+    free(bodies->vy);
+    free(bodies->w);
+    free(bodies->inv_mass);
+    free(bodies->inv_I);
+    free(bodies->ax);
+    free(bodies->ay);
+    free(bodies->aw);
+    free(bodies->dx);
+    free(bodies->dy);
+    free(bodies->dq);
+    *bodies = (SolverBodyArray) { 0 };
+}
+
+void solver_bodies_resize(SolverBodyArray* bodies, uint32_t count) {
+    if (count > bodies->capacity) {
+        uint32_t capacity = bodies->capacity == 0 ? 8 : bodies->capacity;
+        while (capacity < count)
+            capacity *= 2;
+        bodies->vx = solver_realloc(bodies->vx, capacity);
+        bodies->vy = solver_realloc(bodies->vy, capacity);
+        bodies->w = solver_realloc(bodies->w, capacity);
+        bodies->inv_mass = solver_realloc(bodies->inv_mass, capacity);
+        bodies->inv_I = solver_realloc(bodies->inv_I, capacity);
+        bodies->ax = solver_realloc(bodies->ax, capacity);
+        bodies->ay = solver_realloc(bodies->ay, capacity);
+        bodies->aw = solver_realloc(bodies->aw, capacity);
+        bodies->dx = solver_realloc(bodies->dx, capacity);
+        bodies->dy = solver_realloc(bodies->dy, capacity);
+        bodies->dq = solver_realloc(bodies->dq, capacity);
+        bodies->capacity = capacity;
+    }
+    bodies->count = count;
+}
+
+void solver_bodies_load(SolverBodyArray* bodies, uint32_t index, Body* body) {
+    bool is_static = body_is_static(body);
+    bodies->vx[index] = body->velocity.x;
+    bodies->vy[index] = body->velocity.y;
+    bodies->w[index] = body->angular_velocity;
+    bodies->inv_mass[index] = is_static ? 0.0f : body->inv_mass;
+    bodies->inv_I[index] = is_static ? 0.0f : body->inv_I;
+}
+
+void solver_bodies_store(SolverBodyArray* bodies, uint32_t index, Body* body) {
+    body->velocity = VEC2(bodies->vx[index], bodies->vy[index]);
+    body->angular_velocity = bodies->w[index];
+}
+
+void solver_bodies_load_substeps(SolverBodyArray* bodies, uint32_t index, Body* body, float dt) {
+    solver_bodies_load(bodies, index, body);
+    bodies->dx[index] = 0.0f;
+    bodies->dy[index] = 0.0f;
+    bodies->dq[index] = 0.0f;
+    // only the awake bodies had their forces integrated in this step
+    bool has_forces = bodies->inv_mass[index] != 0.0f && !body->sleeping && !body->removed;
+    bodies->ax[index] = has_forces ? body->acceleration.x : 0.0f;
+    bodies->ay[index] = has_forces ? body->acceleration.y : 0.0f;
+    bodies->aw[index] = has_forces ? body->angular_acceleration : 0.0f;
+    bodies->vx[index] -= bodies->ax[index] * dt;
+    bodies->vy[index] -= bodies->ay[index] * dt;
+    // the damping of body_integrate_forces was applied after the acceleration, it stays on the start velocity
+    bodies->w[index] -= bodies->aw[index] * dt * BODY_ANGULAR_DAMPING;
+}
+
+void solver_bodies_integrate_forces(SolverBodyArray* bodies, uint32_t index, float h) {
+    bodies->vx[index] += bodies->ax[index] * h;
+    bodies->vy[index] += bodies->ay[index] * h;
+    bodies->w[index] += bodies->aw[index] * h;
+}
+
+// static bodies are moved once all the islands are done
+void solver_bodies_integrate_velocities(SolverBodyArray* bodies, uint32_t index, float h) {
+    if (bodies->inv_mass[index] == 0.0f)
+        return;
+    bodies->dx[index] += bodies->vx[index] * h;
+    bodies->dy[index] += bodies->vy[index] * h;
+    bodies->dq[index] += bodies->w[index] * h;
+}
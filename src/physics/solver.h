@@ -0,0 +1,36 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "body.h"
+#include <stdint.h>
+
+// packed velocity state of the bodies used by the constraint solver (structure of arrays),
+// indexed like the world's bodies. Static bodies have zero inverse mass and inertia and are never written
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    float* vx;
+    float* vy;
+    float* w;
+    float* inv_mass;
+    float* inv_I;
+    // only used by the substep solver
+    float* ax; // acceleration from the forces, added at every substep
+    float* ay;
+    float* aw;
+    float* dx; // displacement since the start of the step
+    float* dy;
+    float* dq; // rotation since the start of the step
+} SolverBodyArray;
+
+void solver_bodies_free(SolverBodyArray* bodies);
+void solver_bodies_resize(SolverBodyArray* bodies, uint32_t count);
+void solver_bodies_load(SolverBodyArray* bodies, uint32_t index, Body* body);
+void solver_bodies_store(SolverBodyArray* bodies, uint32_t index, Body* body);
+// the forces were already integrated over the whole step, the velocity gives back what they added and they are
+// added again at each substep
+void solver_bodies_load_substeps(SolverBodyArray* bodies, uint32_t index, Body* body, float dt);
+void solver_bodies_integrate_forces(SolverBodyArray* bodies, uint32_t index, float h);
+void solver_bodies_integrate_velocities(SolverBodyArray* bodies, uint32_t index, float h);
+
+#endif // SOLVER_H
@@ -1,11 +1,19 @@
 #include "table.h"
-#include "manifold.h"
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define FREE(x) free(x)
 #define CALLOC(capacity, elemsize) calloc((capacity), (elemsize))
-#define CALC_LOAD_FACTOR(table) (int)(((float)((table)->count + 1) / (table)->capacity) * 100)
+#define MALLOC(capacity, elemsize) malloc((capacity) * (elemsize))
+#define CALC_LOAD_FACTOR(table) (int)(((float)((table)->count + 1) / (table)->slots.capacity) * 100)
+
+#define HT_EMPTY 0
+#define HT_MIGRATE_SLOTS 64 // old slots moved by each insertion or removal while resizing
 
 static uint32_t hash_pair(Pair key) {
     uint32_t k = key.j * key.j + key.i; // Szudzik pairing, i < j
@@ -15,165 +23,307 @@ static uint32_t hash_pair(Pair key) {
     return hash;
 }
 
-static void ht_grow(Table* table) {
-    uint32_t old_capacity = table->capacity;
-    if (table->capacity == 0) {
-        table->capacity = 16;
-    } else {
-        table->capacity *= 2;
+// the low bits of the hash pick the slot, the high ones go in the control byte
+static uint8_t ht_tag(uint32_t hash) {
+    return (uint8_t) (0x80 | (hash >> 25));
+}
+
+static uint32_t ht_home(TableSlots* slots, Pair key) {
+    return hash_pair(key) & (slots->capacity - 1); // mod of 2^n is equal to the last n bits
+}
+
+// bit i is set if ctrl[i] == tag, for the HT_GROUP_SIZE control bytes starting at ctrl
+static uint32_t ht_match(const uint8_t* ctrl, uint8_t tag) {
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128((const __m128i*) ctrl);
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char) tag)));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < HT_GROUP_SIZE; i++) {
+        mask |= (uint32_t) (ctrl[i] == tag) << i;
     }
-    Bucket* old_buckets = table->buckets;
-    table->buckets = CALLOC(table->capacity, sizeof *table->buckets);
-    if (table->buckets == NULL) {
+    return mask;
+#endif
+}
+
+static void ht_set_ctrl(TableSlots* slots, uint32_t index, uint8_t tag) {
+    slots->ctrl[index] = tag;
+    // the copy at the end lets a group that starts near the end wrap around
+    if (index < HT_GROUP_SIZE - 1)
+        slots->ctrl[slots->capacity + index] = tag;
+}
+
+static void ht_alloc(TableSlots* slots, uint32_t capacity) {
+    slots->capacity = capacity;
+    slots->ctrl = CALLOC(capacity + HT_GROUP_SIZE - 1, sizeof *slots->ctrl);
+    slots->entries = MALLOC(capacity, sizeof *slots->entries);
+    if (slots->ctrl == NULL || slots->entries == NULL) {
         printf("ERROR: out of memory, aborting.\n");
         exit(1);
     }
+}
 
-    // create new table from scratch (copy old elements into new table)
-    table->count = 0;
-    for (uint32_t i = 0; i < old_capacity; i++) {
-        Bucket* bucket = &old_buckets[i];
-        if (bucket->occupied) {
-            Manifold* manifold = ht_set(table, bucket->key, bucket->value.num_contacts);
-            *manifold = bucket->value; // copy manifold content
+static void ht_free_slots(TableSlots* slots) {
+    FREE(slots->ctrl);
+    FREE(slots->entries);
+    *slots = (TableSlots) { 0 };
+}
+
+static bool ht_is_resizing(Table* table) {
+    return table->old_slots.ctrl != NULL;
+}
+
+static void ht_add_probes(Table* table, uint32_t probe) {
+    table->probes += probe;
+    if (probe > table->max_probe)
+        table->max_probe = probe;
+}
+
+// slot of the key if found, otherwise the empty slot at the end of its probe chain
+static uint32_t ht_find(Table* table, TableSlots* slots, Pair key, uint32_t hash, bool* found) {
+    uint32_t mask = slots->capacity - 1;
+    uint32_t home = hash & mask;
+    uint8_t tag = ht_tag(hash);
+    for (uint32_t offset = 0;; offset += HT_GROUP_SIZE) {
+        uint32_t index = (home + offset) & mask;
+        uint32_t empty = ht_match(&slots->ctrl[index], HT_EMPTY);
+        uint32_t candidates = ht_match(&slots->ctrl[index], tag);
+        // the chain ends at the first empty slot
+        if (empty != 0)
+            candidates &= (empty & (~empty + 1)) - 1;
+        while (candidates != 0) {
+            uint32_t i = (uint32_t) __builtin_ctz(candidates);
+            uint32_t slot = (index + i) & mask;
+            if (slots->entries[slot].key.i == key.i && slots->entries[slot].key.j == key.j) {
+                *found = true;
+                ht_add_probes(table, offset + i + 1);
+                return slot;
+            }
+            candidates &= candidates - 1;
+        }
+        if (empty != 0) {
+            uint32_t i = (uint32_t) __builtin_ctz(empty);
+            *found = false;
+            ht_add_probes(table, offset + i + 1);
+            return (index + i) & mask;
         }
     }
+}
 
-    FREE(old_buckets);
+static void ht_put(TableSlots* slots, uint32_t slot, Pair key, uint32_t hash, uint32_t value) {
+    ht_set_ctrl(slots, slot, ht_tag(hash));
+    slots->entries[slot] = (Entry) { .key = key, .value = value };
 }
 
-void ht_init(Table* table, uint32_t capacity, uint32_t load_factor) {
-    table->count = 0;
-    table->buckets = NULL;
-    table->load_factor = load_factor;
+// for keys that are known not to be in the slots yet
+static void ht_put_new(TableSlots* slots, Entry* entry) {
+    uint32_t mask = slots->capacity - 1;
+    uint32_t hash = hash_pair(entry->key);
+    uint32_t index = hash & mask;
+    uint32_t empty;
+    while ((empty = ht_match(&slots->ctrl[index], HT_EMPTY)) == 0) {
+        index = (index + HT_GROUP_SIZE) & mask;
+    }
+    ht_put(slots, (index + (uint32_t) __builtin_ctz(empty)) & mask, entry->key, hash, entry->value);
+}
 
-    // init table
-    table->capacity = capacity;
-    table->buckets = CALLOC(table->capacity, sizeof *table->buckets);
-    if (table->buckets == NULL) {
-        printf("ERROR: out of memory, aborting.\n");
-        exit(1);
+// moves the cluster of old slots starting at index to the new slots, except skip, and returns its length.
+// A whole cluster is moved at once, otherwise the empty slots left behind would cut the probe chains
+// of the entries that are still in the old slots
+static uint32_t ht_move_cluster(Table* table, uint32_t index, Entry* skip) {
+    TableSlots* old = &table->old_slots;
+    uint32_t mask = old->capacity - 1;
+    uint32_t length = 0;
+    for (uint32_t i = index; old->ctrl[i] != HT_EMPTY; i = (i + 1) & mask) {
+        if (&old->entries[i] != skip)
+            ht_put_new(&table->slots, &old->entries[i]);
+        length++;
     }
+    for (uint32_t i = 0; i < length; i++) {
+        ht_set_ctrl(old, (index + i) & mask, HT_EMPTY);
+    }
+    return length;
 }
 
-void ht_free(Table* table) {
-    FREE(table->buckets);
+// moves at least num_slots old slots (or all that are left) to the new ones
+static void ht_migrate(Table* table, uint32_t num_slots) {
+    if (!ht_is_resizing(table))
+        return;
+    TableSlots* old = &table->old_slots;
+    uint32_t moved = 0;
+    while (moved < num_slots && table->migrated < old->capacity) {
+        uint32_t index = (table->migrate_start + table->migrated) & (old->capacity - 1);
+        uint32_t length = old->ctrl[index] == HT_EMPTY ? 1 : ht_move_cluster(table, index, NULL);
+        table->migrated += length;
+        moved += length;
+    }
+    if (table->migrated >= old->capacity)
+        ht_free_slots(old);
 }
 
-static Bucket* ht_find(Table* table, Pair key, uint32_t hash) {
-    uint32_t index = hash & (table->capacity - 1); // mod of 2^n is equal to the last n bits
+static void ht_resize(Table* table, uint32_t capacity) {
+    ht_migrate(table, UINT32_MAX);
+    table->old_slots = table->slots;
+    ht_alloc(&table->slots, capacity);
 
-    Bucket* tombstone = NULL;
-    for (;;) {
-        Bucket* bucket = &table->buckets[index];
+    // start after an empty slot, so that no cluster wraps around the end of the move
+    TableSlots* old = &table->old_slots;
+    table->migrate_start = 0;
+    while (old->ctrl[table->migrate_start] != HT_EMPTY) {
+        table->migrate_start++;
+    }
+    table->migrated = 0;
+}
 
-        if (!bucket->occupied) {
-            if (bucket->value.num_contacts == 0) {
-                return tombstone == NULL ? bucket : tombstone;
-            } else {
-                if (tombstone == NULL) {
-                    tombstone = bucket;
-                }
-            }
-        } else if (bucket->key.i == key.i && bucket->key.j == key.j) {
-            return bucket;
-        }
+void ht_init(Table* table, uint32_t capacity, uint32_t load_factor) {
+    uint32_t size = HT_GROUP_SIZE;
+    while (size < capacity) {
+        size *= 2;
+    }
+    table->count = 0;
+    table->load_factor = load_factor;
+    table->min_capacity = size;
+    table->old_slots = (TableSlots) { 0 };
+    ht_reset_stats(table);
+    ht_alloc(&table->slots, size);
+}
+
+void ht_free(Table* table) {
+    ht_free_slots(&table->slots);
+    ht_free_slots(&table->old_slots);
+}
 
-        // linear probing
-        index = (index + 1) & (table->capacity - 1);
+void ht_reserve(Table* table, uint32_t count) {
+    uint32_t size = HT_GROUP_SIZE;
+    while ((uint64_t) count * 100 >= (uint64_t) size * (uint64_t) table->load_factor) {
+        size *= 2;
     }
+    if (size > table->min_capacity)
+        table->min_capacity = size;
+    if (size > table->slots.capacity) {
+        // done before the simulation starts, no need to spread it
+        ht_resize(table, size);
+        ht_migrate(table, UINT32_MAX);
+    }
+}
+
+void ht_clear(Table* table) {
+    ht_free_slots(&table->old_slots);
+    memset(table->slots.ctrl, HT_EMPTY, table->slots.capacity + HT_GROUP_SIZE - 1);
+    table->count = 0;
 }
 
 bool ht_remove(Table* table, Pair key) {
     if (table->count == 0) 
         return false;
+    ht_migrate(table, HT_MIGRATE_SLOTS);
     uint32_t hash = hash_pair(key);
-    Bucket* bucket = ht_find(table, key, hash);
-    if (!bucket->occupied)
-        return false;
+    bool found = false;
+    table->lookups++;
+    TableSlots* slots = &table->slots;
+    uint32_t hole = ht_find(table, slots, key, hash, &found);
+    if (!found) {
+        if (!ht_is_resizing(table))
+            return false;
+        // not moved yet, its cluster is moved now without it
+        TableSlots* old = &table->old_slots;
+        uint32_t mask = old->capacity - 1;
+        uint32_t slot = ht_find(table, old, key, hash, &found);
+        if (!found)
+            return false;
+        uint32_t start = slot;
+        while (old->ctrl[(start - 1) & mask] != HT_EMPTY) {
+            start = (start - 1) & mask;
+        }
+        ht_move_cluster(table, start, &old->entries[slot]);
+        table->count--;
+        return true;
+    }
 
-    // place tombstone
-    bucket->occupied = false;
-    bucket->value.num_contacts = 1;
+    // backward shift: move back the entries of the chain that can be found from the hole
+    uint32_t mask = slots->capacity - 1;
+    for (uint32_t next = (hole + 1) & mask; slots->ctrl[next] != HT_EMPTY; next = (next + 1) & mask) {
+        uint32_t home = ht_home(slots, slots->entries[next].key);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            ht_set_ctrl(slots, hole, slots->ctrl[next]);
+            slots->entries[hole] = slots->entries[next];
+            hole = next;
+        }
+    }
+    ht_set_ctrl(slots, hole, HT_EMPTY);
+    table->count--;
+
+    // give the memory back after a peak
+    if (!ht_is_resizing(table) && slots->capacity > table->min_capacity
+            && (uint64_t) table->count * 400 < (uint64_t) slots->capacity * (uint64_t) table->load_factor)
+        ht_resize(table, slots->capacity / 2);
     return true;
 }
 
-void ht_remove_bucket(Bucket* bucket) {
-    bucket->occupied = false;
-    bucket->value.num_contacts = 1;
+void ht_reset_stats(Table* table) {
+    table->lookups = 0;
+    table->probes = 0;
+    table->max_probe = 0;
 }
 
-Manifold* ht_get(Table* table, Pair key) {
+uint32_t* ht_get(Table* table, Pair key) {
     if (table->count == 0)
         return NULL;
     uint32_t hash = hash_pair(key);
-    Bucket* bucket = ht_find(table, key, hash);
-    if (!bucket->occupied)
-        return NULL;
-    return &bucket->value;
-}
-
-Manifold* ht_set(Table* table, Pair key, uint32_t num_contacts) {
-    if (CALC_LOAD_FACTOR(table) >= table->load_factor) {
-        ht_grow(table);
+    bool found = false;
+    table->lookups++;
+    uint32_t slot = ht_find(table, &table->slots, key, hash, &found);
+    if (found)
+        return &table->slots.entries[slot].value;
+    if (ht_is_resizing(table)) {
+        slot = ht_find(table, &table->old_slots, key, hash, &found);
+        if (found)
+            return &table->old_slots.entries[slot].value;
     }
+    return NULL;
+}
 
-    uint32_t hash = hash_pair(key);
-    Bucket* bucket = ht_find(table, key, hash);
-
-    if (!bucket->occupied && bucket->value.num_contacts == 0) {
-        // new item
-        table->count++;
-    }
-    
-    bucket->key = key;
-    manifold_init(&bucket->value, num_contacts, key.i, key.j);
-    bucket->occupied = true;
-    return &bucket->value;
+uint32_t* ht_set(Table* table, Pair key, uint32_t value) {
+    bool found = false;
+    uint32_t* slot_value = ht_get_or_new(table, key, value, &found);
+    *slot_value = value;
+    return slot_value;
 }
 
-Manifold* ht_get_or_new(Table* table, Pair key, uint32_t num_contacts, bool* found) {
-    // tries to find manifold, if not found create a new one
+uint32_t* ht_get_or_new(Table* table, Pair key, uint32_t value, bool* found) {
+    // tries to find the key, if not found insert it
+    ht_migrate(table, HT_MIGRATE_SLOTS);
     if (CALC_LOAD_FACTOR(table) >= table->load_factor) {
-        ht_grow(table);
+        ht_resize(table, table->slots.capacity * 2);
     }
 
     uint32_t hash = hash_pair(key);
-    Bucket* bucket = ht_find(table, key, hash);
-
-    if (bucket->occupied) {
-        *found = true;
-        return &bucket->value;
-    }
-
-    *found = false;
-
-    if (!bucket->occupied && bucket->value.num_contacts == 0) {
-        // new item
-        table->count++;
+    table->lookups++;
+    uint32_t slot = ht_find(table, &table->slots, key, hash, found);
+    if (*found)
+        return &table->slots.entries[slot].value;
+    if (ht_is_resizing(table)) {
+        uint32_t old_slot = ht_find(table, &table->old_slots, key, hash, found);
+        if (*found)
+            return &table->old_slots.entries[old_slot].value;
     }
-    
-    bucket->key = key;
-    manifold_init(&bucket->value, num_contacts, key.i, key.j);
-    bucket->occupied = true;
-    return &bucket->value;
+    ht_put(&table->slots, slot, key, hash, value);
+    table->count++;
+    return &table->slots.entries[slot].value;
 }
 
 
 void ht_print(Table* table) {
     printf("===== TABLE =====\n");
-    for (uint32_t i = 0; i < table->capacity; i++) {
-        Bucket* bucket = &table->buckets[i];
-        if (bucket->occupied) {
-            printf("(%d, %d): (%d, %d)\n", bucket->key.i, bucket->key.j, bucket->value.a_index, bucket->value.b_index);
+    for (uint32_t i = 0; i < table->slots.capacity; i++) {
+        if (table->slots.ctrl[i] != HT_EMPTY) {
+            Entry* entry = &table->slots.entries[i];
+            printf("(%d, %d): %d [home %d]\n", entry->key.i, entry->key.j, entry->value, ht_home(&table->slots, entry->key));
         } else {
-            if (bucket->value.num_contacts == 0) {
-                printf("NULL\n");
-            } else {
-                printf("[Tombstone]\n");
-            }
+            printf("NULL\n");
         }
     }
+    if (ht_is_resizing(table))
+        printf("(%d old slots not moved yet)\n", table->old_slots.capacity - table->migrated);
     printf("=================\n");
 }
-
@@ -1,7 +1,6 @@
 #ifndef TABLE_H
 #define TABLE_H
 
-#include "manifold.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -12,25 +11,57 @@ typedef struct {
 } Pair;
 
 typedef struct {
-    Manifold value;
+    uint32_t capacity;
+    uint32_t count;
+    Pair* items;
+} PairArray;
+
+typedef struct {
     Pair key;
-    bool occupied;
-} Bucket;
+    uint32_t value;
+} Entry;
 
+// slots scanned at once when probing
+#define HT_GROUP_SIZE 16
+
+typedef struct {
+    uint32_t capacity; // power of 2, at least HT_GROUP_SIZE
+    uint8_t* ctrl; // capacity + HT_GROUP_SIZE - 1, the first group is repeated at the end
+    Entry* entries;
+} TableSlots;
+
+// linear probing without tombstones: a removal shifts back the rest of the probe chain.
+// The control bytes (0 for an empty slot, otherwise 7 bits of the hash with the high bit set)
+// are scanned a group at a time and the keys are only read for the slots whose control byte matches.
+// Resizing is incremental: the old slots are kept and every insertion or removal moves a few
+// clusters of them to the new ones, lookups check both until the old slots are empty
 typedef struct {
     uint32_t count;
-    uint32_t capacity;
-    int load_factor;
-    Bucket* buckets;
+    uint32_t min_capacity; // the table doesn't shrink below its initial or reserved capacity
+    int load_factor; // grows above this percentage, shrinks below a quarter of it
+    TableSlots slots;
+    TableSlots old_slots; // being moved to slots, ctrl is NULL when there is no resize going on
+    uint32_t migrate_start; // empty slot of old_slots where the move started
+    uint32_t migrated; // old slots moved so far, starting from migrate_start
+    // probing statistics since the last ht_reset_stats
+    uint32_t lookups;
+    uint32_t probes; // slots visited by all the lookups
+    uint32_t max_probe;
 } Table;
 
 void ht_init(Table* table, uint32_t capacity, uint32_t load_factor);
 void ht_free(Table* table);
+// makes room for count keys without resizing, and keeps the table from shrinking below that
+void ht_reserve(Table* table, uint32_t count);
+// removes all the keys, keeping the capacity
+void ht_clear(Table* table);
 bool ht_remove(Table* table, Pair key);
-void ht_remove_bucket(Bucket* bucket);
-Manifold* ht_get(Table* table, Pair key);
-Manifold* ht_set(Table* table, Pair key, uint32_t num_contacts);
-Manifold* ht_get_or_new(Table* table, Pair key, uint32_t num_contacts, bool* found);
+void ht_reset_stats(Table* table);
+uint32_t* ht_get(Table* table, Pair key);
+uint32_t* ht_set(Table* table, Pair key, uint32_t value);
+// the value is only stored if the key is new.
+// The returned pointers are valid until the next insertion or removal
+uint32_t* ht_get_or_new(Table* table, Pair key, uint32_t value, bool* found);
 
 // debug
 void ht_print(Table* table);
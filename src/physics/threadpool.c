@@ -0,0 +1,128 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "threadpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static void threadpool_work(ThreadPool* pool, TaskFunction function, void* context, uint32_t num_tasks) {
+    for (;;) {
+        uint32_t task = __atomic_fetch_add(&pool->next_task, 1, __ATOMIC_RELAXED);
+        if (task >= num_tasks)
+            break;
+        function(context, task);
+    }
+}
+
+static void* threadpool_worker(void* arg) {
+    ThreadPool* pool = arg;
+    uint64_t seen_generation = 0;
+    for (;;) {
+        pthread_mutex_lock(&pool->mutex);
+        while (!pool->quit && pool->generation == seen_generation) {
+            pthread_cond_wait(&pool->work_cond, &pool->mutex);
+        }
+        if (pool->quit) {
+            pthread_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+        seen_generation = pool->generation;
+        TaskFunction function = pool->function;
+        void* context = pool->context;
+        uint32_t num_tasks = pool->num_tasks;
+        pthread_mutex_unlock(&pool->mutex);
+
+        threadpool_work(pool, function, context, num_tasks);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->busy_workers == 0)
+            pthread_cond_signal(&pool->done_cond);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+void threadpool_init(ThreadPool* pool, uint32_t num_threads) {
+    pool->num_workers = num_threads > 1 ? num_threads - 1 : 0;
+    pool->workers = NULL;
+    pool->function = NULL;
+    pool->context = NULL;
+    pool->num_tasks = 0;
+    pool->next_task = 0;
+    pool->busy_workers = 0;
+    pool->generation = 0;
+    pool->quit = false;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    if (pool->num_workers == 0)
+        return;
+
+    pool->workers = malloc(pool->num_workers * sizeof *pool->workers);
+    if (pool->workers == NULL) {
+        printf("ERROR: out of memory, aborting.\n");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < pool->num_workers; i++) {
+        if (pthread_create(&pool->workers[i], NULL, threadpool_worker, pool) != 0) {
+            printf("ERROR: could not create thread, aborting.\n");
+            exit(1);
+        }
+    }
+}
+
+void threadpool_free(ThreadPool* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+    for (uint32_t i = 0; i < pool->num_workers; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+    free(pool->workers);
+    pool->workers = NULL;
+    pool->num_workers = 0;
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_cond_destroy(&pool->done_cond);
+}
+
+void threadpool_run(ThreadPool* pool, uint32_t num_tasks, TaskFunction function, void* context) {
+    if (num_tasks == 0)
+        return;
+
+    // not worth waking up the workers
+    if (pool->num_workers == 0 || num_tasks == 1) {
+        for (uint32_t i = 0; i < num_tasks; i++) {
+            function(context, i);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->function = function;
+    pool->context = context;
+    pool->num_tasks = num_tasks;
+    pool->next_task = 0;
+    pool->busy_workers = pool->num_workers;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    threadpool_work(pool, function, context, num_tasks);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->busy_workers > 0) {
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+uint32_t threadpool_num_threads(ThreadPool* pool) {
+    return pool->num_workers + 1;
+}
+
+uint32_t threadpool_num_cores(void) {
+    long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return num_cores > 0 ? (uint32_t) num_cores : 1;
+}
@@ -0,0 +1,35 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// called once for every task index in [0, num_tasks)
+typedef void (*TaskFunction)(void* context, uint32_t task_index);
+
+// a minimal parallel-for: the calling thread works too, so a pool of N threads has N - 1 workers.
+// Tasks are claimed one at a time with an atomic counter
+typedef struct {
+    pthread_t* workers;
+    uint32_t num_workers;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    TaskFunction function;
+    void* context;
+    uint32_t num_tasks;
+    uint32_t next_task;
+    uint32_t busy_workers;
+    uint64_t generation; // incremented every run so that workers know there is new work
+    bool quit;
+} ThreadPool;
+
+void threadpool_init(ThreadPool* pool, uint32_t num_threads);
+void threadpool_free(ThreadPool* pool);
+// runs all the tasks and returns when they are done
+void threadpool_run(ThreadPool* pool, uint32_t num_tasks, TaskFunction function, void* context);
+uint32_t threadpool_num_threads(ThreadPool* pool);
+uint32_t threadpool_num_cores(void);
+
+#endif // THREADPOOL_H
@@ -0,0 +1,306 @@
+#include "tree.h"
+#include "array.h"
+#include <math.h>
+
+#define NODE(tree, index) ((tree)->nodes.items[(index)])
+
+#define AABB_MARGIN 0.1f // 10 cm
+#define AABB_MULTIPLIER 4.0f // how far ahead the fat aabb is predicted along the displacement
+
+static bool node_is_leaf(TreeNode* node) {
+    return node->child1 == TREE_NULL_NODE;
+}
+
+static int max_int(int a, int b) {
+    return a > b ? a : b;
+}
+
+static int tree_allocate_node(DynamicTree* tree) {
+    int index;
+    if (tree->free_list != TREE_NULL_NODE) {
+        index = tree->free_list;
+        tree->free_list = NODE(tree, index).parent;
+    } else {
+        DA_NEXT_PTR(&tree->nodes);
+        index = tree->nodes.count - 1;
+    }
+    TreeNode* node = &NODE(tree, index);
+    node->parent = TREE_NULL_NODE;
+    node->child1 = TREE_NULL_NODE;
+    node->child2 = TREE_NULL_NODE;
+    node->height = 0;
+    node->user_data = -1;
+    return index;
+}
+
+static void tree_free_node(DynamicTree* tree, int index) {
+    NODE(tree, index).parent = tree->free_list;
+    NODE(tree, index).height = -1;
+    tree->free_list = index;
+}
+
+static void tree_replace_child(DynamicTree* tree, int parent, int old_child, int new_child) {
+    if (parent == TREE_NULL_NODE) {
+        tree->root = new_child;
+    } else if (NODE(tree, parent).child1 == old_child) {
+        NODE(tree, parent).child1 = new_child;
+    } else {
+        NODE(tree, parent).child2 = new_child;
+    }
+}
+
+// performs a left or right rotation if node A is imbalanced, returns the new root of the subtree
+static int tree_balance(DynamicTree* tree, int ia) {
+    TreeNode* a = &NODE(tree, ia);
+    if (node_is_leaf(a) || a->height < 2)
+        return ia;
+
+    int ib = a->child1;
+    int ic = a->child2;
+    TreeNode* b = &NODE(tree, ib);
+    TreeNode* c = &NODE(tree, ic);
+    int balance = c->height - b->height;
+
+    if (balance > 1) {
+        // rotate C up
+        int i_f = c->child1;
+        int ig = c->child2;
+        TreeNode* f = &NODE(tree, i_f);
+        TreeNode* g = &NODE(tree, ig);
+
+        c->child1 = ia;
+        c->parent = a->parent;
+        a->parent = ic;
+        tree_replace_child(tree, c->parent, ia, ic);
+
+        if (f->height > g->height) {
+            c->child2 = i_f;
+            a->child2 = ig;
+            g->parent = ia;
+            a->aabb = aabb_union(b->aabb, g->aabb);
+            c->aabb = aabb_union(a->aabb, f->aabb);
+            a->height = 1 + max_int(b->height, g->height);
+            c->height = 1 + max_int(a->height, f->height);
+        } else {
+            c->child2 = ig;
+            a->child2 = i_f;
+            f->parent = ia;
+            a->aabb = aabb_union(b->aabb, f->aabb);
+            c->aabb = aabb_union(a->aabb, g->aabb);
+            a->height = 1 + max_int(b->height, f->height);
+            c->height = 1 + max_int(a->height, g->height);
+        }
+        return ic;
+    }
+
+    if (balance < -1) {
+        // rotate B up
+        int id = b->child1;
+        int ie = b->child2;
+        TreeNode* d = &NODE(tree, id);
+        TreeNode* e = &NODE(tree, ie);
+
+        b->child1 = ia;
+        b->parent = a->parent;
+        a->parent = ib;
+        tree_replace_child(tree, b->parent, ia, ib);
+
+        if (d->height > e->height) {
+            b->child2 = id;
+            a->child1 = ie;
+            e->parent = ia;
+            a->aabb = aabb_union(c->aabb, e->aabb);
+            b->aabb = aabb_union(a->aabb, d->aabb);
+            a->height = 1 + max_int(c->height, e->height);
+            b->height = 1 + max_int(a->height, d->height);
+        } else {
+            b->child2 = ie;
+            a->child1 = id;
+            d->parent = ia;
+            a->aabb = aabb_union(c->aabb, d->aabb);
+            b->aabb = aabb_union(a->aabb, e->aabb);
+            a->height = 1 + max_int(c->height, d->height);
+            b->height = 1 + max_int(a->height, e->height);
+        }
+        return ib;
+    }
+
+    return ia;
+}
+
+// walk back up the tree fixing heights and aabbs
+static void tree_refit_ancestors(DynamicTree* tree, int index) {
+    while (index != TREE_NULL_NODE) {
+        index = tree_balance(tree, index);
+        TreeNode* node = &NODE(tree, index);
+        TreeNode* child1 = &NODE(tree, node->child1);
+        TreeNode* child2 = &NODE(tree, node->child2);
+        node->height = 1 + max_int(child1->height, child2->height);
+        node->aabb = aabb_union(child1->aabb, child2->aabb);
+        index = node->parent;
+    }
+}
+
+static void tree_insert_leaf(DynamicTree* tree, int leaf) {
+    if (tree->root == TREE_NULL_NODE) {
+        tree->root = leaf;
+        NODE(tree, leaf).parent = TREE_NULL_NODE;
+        return;
+    }
+
+    // find the best sibling by descending the tree with the perimeter cost
+    AABB leaf_aabb = NODE(tree, leaf).aabb;
+    int index = tree->root;
+    while (!node_is_leaf(&NODE(tree, index))) {
+        TreeNode* node = &NODE(tree, index);
+        float area = aabb_perimeter(node->aabb);
+        float combined_area = aabb_perimeter(aabb_union(node->aabb, leaf_aabb));
+
+        // cost of creating a new parent for this node and the new leaf
+        float cost = 2.0f * combined_area;
+        // minimum cost of pushing the leaf further down the tree
+        float inheritance_cost = 2.0f * (combined_area - area);
+
+        float child_costs[2];
+        int children[2] = { node->child1, node->child2 };
+        for (int c = 0; c < 2; c++) {
+            TreeNode* child = &NODE(tree, children[c]);
+            float new_area = aabb_perimeter(aabb_union(leaf_aabb, child->aabb));
+            if (node_is_leaf(child)) {
+                child_costs[c] = new_area + inheritance_cost;
+            } else {
+                child_costs[c] = (new_area - aabb_perimeter(child->aabb)) + inheritance_cost;
+            }
+        }
+
+        if (cost < child_costs[0] && cost < child_costs[1])
+            break;
+
+        index = child_costs[0] < child_costs[1] ? children[0] : children[1];
+    }
+    int sibling = index;
+
+    // create a new parent
+    int old_parent = NODE(tree, sibling).parent;
+    int new_parent = tree_allocate_node(tree);
+    NODE(tree, new_parent).parent = old_parent;
+    NODE(tree, new_parent).aabb = aabb_union(leaf_aabb, NODE(tree, sibling).aabb);
+    NODE(tree, new_parent).height = NODE(tree, sibling).height + 1;
+    NODE(tree, new_parent).child1 = sibling;
+    NODE(tree, new_parent).child2 = leaf;
+    tree_replace_child(tree, old_parent, sibling, new_parent);
+    NODE(tree, sibling).parent = new_parent;
+    NODE(tree, leaf).parent = new_parent;
+
+    tree_refit_ancestors(tree, NODE(tree, leaf).parent);
+}
+
+static void tree_remove_leaf(DynamicTree* tree, int leaf) {
+    if (leaf == tree->root) {
+        tree->root = TREE_NULL_NODE;
+        return;
+    }
+
+    int parent = NODE(tree, leaf).parent;
+    int grand_parent = NODE(tree, parent).parent;
+    int sibling = NODE(tree, parent).child1 == leaf ? NODE(tree, parent).child2 : NODE(tree, parent).child1;
+
+    // destroy the parent and connect the sibling to the grand parent
+    tree_replace_child(tree, grand_parent, parent, sibling);
+    NODE(tree, sibling).parent = grand_parent;
+    tree_free_node(tree, parent);
+
+    tree_refit_ancestors(tree, grand_parent);
+}
+
+void tree_init(DynamicTree* tree) {
+    tree->nodes = (TreeNodeArray) DA_NULL;
+    tree->stack = (IntArray) DA_NULL;
+    tree->root = TREE_NULL_NODE;
+    tree->free_list = TREE_NULL_NODE;
+}
+
+void tree_free(DynamicTree* tree) {
+    DA_FREE(&tree->nodes);
+    DA_FREE(&tree->stack);
+    tree->root = TREE_NULL_NODE;
+    tree->free_list = TREE_NULL_NODE;
+}
+
+int tree_insert(DynamicTree* tree, AABB aabb, int user_data) {
+    int proxy = tree_allocate_node(tree);
+    NODE(tree, proxy).aabb = aabb_fatten(aabb, AABB_MARGIN);
+    NODE(tree, proxy).user_data = user_data;
+    NODE(tree, proxy).height = 0;
+    tree_insert_leaf(tree, proxy);
+    return proxy;
+}
+
+void tree_remove(DynamicTree* tree, int proxy) {
+    tree_remove_leaf(tree, proxy);
+    tree_free_node(tree, proxy);
+}
+
+bool tree_move(DynamicTree* tree, int proxy, AABB aabb, Vec2 displacement) {
+    AABB tree_aabb = NODE(tree, proxy).aabb;
+    if (aabb_contains(tree_aabb, aabb)) {
+        // the fat aabb still contains the body, but if it is way too large (the body slowed
+        // down after moving fast) it has to be shrunk, otherwise it generates useless pairs
+        AABB huge_aabb = aabb_fatten(aabb, 4.0f * AABB_MARGIN);
+        if (aabb_contains(huge_aabb, tree_aabb))
+            return false;
+    }
+
+    // extend the aabb in the direction of motion
+    AABB fat_aabb = aabb_fatten(aabb, AABB_MARGIN);
+    Vec2 d = vec2_mult(displacement, AABB_MULTIPLIER);
+    if (d.x < 0.0f)
+        fat_aabb.min.x += d.x;
+    else
+        fat_aabb.max.x += d.x;
+    if (d.y < 0.0f)
+        fat_aabb.min.y += d.y;
+    else
+        fat_aabb.max.y += d.y;
+
+    tree_remove_leaf(tree, proxy);
+    NODE(tree, proxy).aabb = fat_aabb;
+    tree_insert_leaf(tree, proxy);
+    return true;
+}
+
+AABB tree_get_fat_aabb(DynamicTree* tree, int proxy) {
+    return NODE(tree, proxy).aabb;
+}
+
+void tree_set_user_data(DynamicTree* tree, int proxy, int user_data) {
+    tree->nodes.items[proxy].user_data = user_data;
+}
+
+void tree_query(DynamicTree* tree, AABB aabb, TreeQueryCallback callback, void* context) {
+    if (tree->root == TREE_NULL_NODE)
+        return;
+
+    tree->stack.count = 0;
+    DA_APPEND(&tree->stack, tree->root);
+    while (tree->stack.count > 0) {
+        int index = tree->stack.items[--tree->stack.count];
+        TreeNode* node = &NODE(tree, index);
+        if (!aabb_overlaps(node->aabb, aabb))
+            continue;
+
+        if (node_is_leaf(node)) {
+            if (!callback(context, node->user_data))
+                return;
+        } else {
+            DA_APPEND(&tree->stack, node->child1);
+            DA_APPEND(&tree->stack, node->child2);
+        }
+    }
+}
+
+int tree_height(DynamicTree* tree) {
+    if (tree->root == TREE_NULL_NODE)
+        return 0;
+    return NODE(tree, tree->root).height;
+}
@@ -0,0 +1,48 @@
+#ifndef TREE_H
+#define TREE_H
+
+#include "aabb.h"
+#include "array.h"
+#include <stdbool.h>
+
+#define TREE_NULL_NODE (-1)
+
+typedef struct {
+    AABB aabb; // fat aabb for leaves, union of the children for internal nodes
+    int parent; // next free node when the node is in the free list
+    int child1;
+    int child2;
+    int height; // leaves have height 0, free nodes -1
+    int user_data; // body index for leaves
+} TreeNode;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    TreeNode* items;
+} TreeNodeArray;
+
+// dynamic AABB tree (same idea as Box2D's b2DynamicTree): leaves store enlarged
+// aabbs so that a proxy only needs to be reinserted when its body moves out of it
+typedef struct {
+    TreeNodeArray nodes;
+    IntArray stack; // scratch stack for queries
+    int root;
+    int free_list;
+} DynamicTree;
+
+typedef bool (*TreeQueryCallback)(void* context, int user_data);
+
+void tree_init(DynamicTree* tree);
+void tree_free(DynamicTree* tree);
+int tree_insert(DynamicTree* tree, AABB aabb, int user_data);
+void tree_remove(DynamicTree* tree, int proxy);
+// returns true if the proxy had to be reinserted
+bool tree_move(DynamicTree* tree, int proxy, AABB aabb, Vec2 displacement);
+AABB tree_get_fat_aabb(DynamicTree* tree, int proxy);
+void tree_set_user_data(DynamicTree* tree, int proxy, int user_data);
+// the callback returns false to stop the query
+void tree_query(DynamicTree* tree, AABB aabb, TreeQueryCallback callback, void* context);
+int tree_height(DynamicTree* tree);
+
+#endif // TREE_H
@@ -1,3 +1,13 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "utils.h"
+#include <stdint.h>
+#include <time.h>
+
+float PIXELS_PER_METER = 100.0f;
 
-float PIXELS_PER_METER = 100.0f; 
+uint64_t time_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
@@ -2,6 +2,7 @@
 #define UTILS_H
 
 #include <math.h>
+#include <stdint.h>
 
 #define MIN_FPS 30.0f
 #define MIN_SECS_PER_FRAME (1.0f / MIN_FPS)
@@ -9,6 +10,9 @@
 
 extern float PIXELS_PER_METER; 
 
+// monotonic clock, for timing
+uint64_t time_now_ns(void);
+
 static inline float clamp(float value, float min, float max) {
     return fmax(fmin(max, value), min); 
 }
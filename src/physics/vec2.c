@@ -24,6 +24,24 @@ Vec2 vec2_rotate(Vec2 v, float angle) {
     };
 }
 
+Rotation rotation_from_angle(float angle) {
+    return (Rotation) { .c = cosf(angle), .s = sinf(angle) };
+}
+
+Vec2 vec2_rotate_by(Vec2 v, Rotation rotation) {
+    return (Vec2) {
+        v.x * rotation.c - v.y * rotation.s,
+        v.x * rotation.s + v.y * rotation.c
+    };
+}
+
+Vec2 vec2_inv_rotate_by(Vec2 v, Rotation rotation) {
+    return (Vec2) {
+        v.x * rotation.c + v.y * rotation.s,
+        -v.x * rotation.s + v.y * rotation.c
+    };
+}
+
 float vec2_magnitude(Vec2 v) {
     return sqrtf(v.x * v.x + v.y * v.y);
 }
@@ -17,11 +17,20 @@ typedef struct {
     Vec2* items;
 } Vec2Array;
 
+// cosine and sine of an angle, so that rotating many points by it needs no trigonometry
+typedef struct {
+    float c;
+    float s;
+} Rotation;
+
 Vec2 vec2_sub(Vec2 a, Vec2 b);
 Vec2 vec2_add(Vec2 a, Vec2 b);
 Vec2 vec2_mult(Vec2 v, float f);
 Vec2 vec2_div(Vec2 v, float f);
 Vec2 vec2_rotate(Vec2 v, float angle);
+Rotation rotation_from_angle(float angle);
+Vec2 vec2_rotate_by(Vec2 v, Rotation rotation);
+Vec2 vec2_inv_rotate_by(Vec2 v, Rotation rotation); // rotates by minus the angle
 float vec2_magnitude(Vec2 v);
 float vec2_magnitude_squared(Vec2 v);
 Vec2 vec2_normalize(Vec2 v);
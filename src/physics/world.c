@@ -1,55 +1,881 @@
 #include "world.h"
 #include "array.h"
+#include "broadphase.h"
+#include "ccd.h"
 #include "constraint.h"
+#include "contact_solver.h"
 #include "collision.h"
+#include "graph.h"
+#include "island.h"
+#include "threadpool.h"
+#include "utils.h"
 #include "manifold.h"
-#include <raylib.h>
+#include "solver.h"
+#include <string.h>
 
 #define SOLVE_ITERATIONS 8
+#define GRAPH_MIN_CONSTRAINTS 128 // smaller islands are solved by a single thread
+#define GRAPH_BATCH_SIZE 32 // constraints (or bodies) per task when solving a big island
+#define VERTICES_BATCH_SIZE 256 // bodies per task when transforming the vertices
+#define NARROW_PHASE_BATCH_SIZE 64 // pairs per task in the narrow phase
+#define SUBSTEP_CONTACT_HERTZ 60.0f // stiffness of the soft contacts, at most a quarter of the substep rate. Softer stacks of
+                                    // more than ~15 boxes lean over
+#define SUBSTEP_CONTACT_DAMPING_RATIO 10.0f
+#define SUBSTEP_JOINT_DAMPING_RATIO 2.0f // joints are twice as stiff as the contacts
 
 void world_init(World* world, float gravity) {
     world->gravity = gravity; // y points down in screen space
     ht_init(&world->manifold_map, 16, 70);
+    broadphase_init(&world->broadphase);
+    island_init(&world->islands);
+    graph_init(&world->graph);
+    world->allow_sleep = true;
+    contact_solver_init(&world->contact_solver, true);
+    threadpool_init(&world->thread_pool, 1);
 }
 
 void world_free(World* world) {
-    for (uint32_t i = 0; i < world->bodies.count; i++) {
-        Body* body = &world->bodies.items[i];
-        bool is_polygon = body->shape.type == SHAPE_POLYGON || body->shape.type == SHAPE_BOX;
-        if (is_polygon) {
-            DA_FREE(&body->shape.as.polygon.local_vertices);
-            DA_FREE(&body->shape.as.polygon.world_vertices);
-            DA_FREE(&body->shape.as.polygon.prev_world_vertices);
-        }
-    }
 
     ht_free(&world->manifold_map);
+    DA_FREE(&world->manifolds);
+    broadphase_free(&world->broadphase);
+    DA_FREE(&world->pair_contacts);
+    island_free(&world->islands);
+    graph_free(&world->graph);
+    solver_bodies_free(&world->solver_bodies);
+    DA_FREE(&world->contact_rows);
+    DA_FREE(&world->contact_row_counts);
+    threadpool_free(&world->thread_pool);
     DA_FREE(&world->joint_constraints);
     DA_FREE(&world->bodies);
+    DA_FREE(&world->body_generations);
+    DA_FREE(&world->free_bodies);
+    DA_FREE(&world->removed_bodies);
     DA_FREE(&world->forces);
     DA_FREE(&world->torques);
 }
 
 Body* world_new_body(World* world) {
-    return DA_NEXT_PTR(&world->bodies);
+    Body* body;
+    if (world->free_bodies.count > 0) {
+        body = &world->bodies.items[world->free_bodies.items[--world->free_bodies.count]];
+    } else {
+        body = DA_NEXT_PTR(&world->bodies);
+        // slots cut by world_compact keep their generation
+        if (world->body_generations.count < world->bodies.count)
+            DA_APPEND(&world->body_generations, 0);
+    }
+    body->removed = false;
+    return body;
+}
+
+BodyHandle world_body_handle(World* world, Body* body) {
+    uint32_t index = (uint32_t) (body - world->bodies.items);
+    return (BodyHandle) { .index = index, .generation = (uint32_t) world->body_generations.items[index] };
+}
+
+Body* world_get_body(World* world, BodyHandle handle) {
+    if (handle.index >= world->bodies.count || (uint32_t) world->body_generations.items[handle.index] != handle.generation)
+        return NULL;
+    return &world->bodies.items[handle.index];
+}
+
+bool world_remove_body(World* world, BodyHandle handle) {
+    Body* body = world_get_body(world, handle);
+    if (body == NULL)
+        return false;
+    body->removed = true;
+    world->body_generations.items[handle.index]++;
+    DA_APPEND(&world->removed_bodies, (int) handle.index);
+    return true;
+}
+
+static void world_wake_if_alive(Body* body) {
+    if (!body->removed && body->sleeping)
+        body_wake(body);
+}
+
+// drops the manifolds and the joints of the bodies removed since the last update, so that their slots can be reused
+static void world_drop_removed_constraints(World* world) {
+    if (world->removed_bodies.count == 0)
+        return;
+    for (uint32_t c = 0; c < world->manifolds.count; c++) {
+        Manifold* manifold = &world->manifolds.items[c];
+        Body* a = &world->bodies.items[manifold->a_index];
+        Body* b = &world->bodies.items[manifold->b_index];
+        if (!a->removed && !b->removed)
+            continue;
+        world_wake_if_alive(a);
+        world_wake_if_alive(b);
+        world_remove_manifold(world, c--);
+    }
+    // joints keep their order
+    uint32_t count = 0;
+    for (uint32_t c = 0; c < world->joint_constraints.count; c++) {
+        JointConstraint* joint = &world->joint_constraints.items[c];
+        Body* a = &world->bodies.items[joint->a_index];
+        Body* b = &world->bodies.items[joint->b_index];
+        if (a->removed || b->removed) {
+            world_wake_if_alive(a);
+            world_wake_if_alive(b);
+            continue;
+        }
+        world->joint_constraints.items[count++] = *joint;
+    }
+    world->joint_constraints.count = count;
+
+    for (uint32_t i = 0; i < world->removed_bodies.count; i++) {
+        DA_APPEND(&world->free_bodies, world->removed_bodies.items[i]);
+    }
+    world->removed_bodies.count = 0;
+}
+
+static void world_rebuild_manifold_map(World* world) {
+    ht_clear(&world->manifold_map);
+    for (uint32_t c = 0; c < world->manifolds.count; c++) {
+        Manifold* manifold = &world->manifolds.items[c];
+        ht_set(&world->manifold_map, (Pair) { .i = manifold->a_index, .j = manifold->b_index }, c);
+    }
+}
+
+void world_compact(World* world, IntArray* remap) {
+    world_drop_removed_constraints(world);
+    IntArray new_index = DA_NULL;
+    DA_RESERVE(&new_index, world->bodies.count);
+    new_index.count = world->bodies.count;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < world->bodies.count; i++) {
+        if (world->bodies.items[i].removed) {
+            new_index.items[i] = -1;
+            continue;
+        }
+        if (count != i)
+            world->bodies.items[count] = world->bodies.items[i];
+        new_index.items[i] = (int) count++;
+    }
+    // from the first removed slot on, every slot holds another body or none
+    for (uint32_t i = 0; i < world->bodies.count; i++) {
+        if (new_index.items[i] != (int) i)
+            world->body_generations.items[i]++;
+    }
+    world->free_bodies.count = 0;
+
+    for (uint32_t c = 0; c < world->manifolds.count; c++) {
+        Manifold* manifold = &world->manifolds.items[c];
+        manifold->a_index = new_index.items[manifold->a_index];
+        manifold->b_index = new_index.items[manifold->b_index];
+    }
+    world_rebuild_manifold_map(world);
+    for (uint32_t c = 0; c < world->joint_constraints.count; c++) {
+        JointConstraint* joint = &world->joint_constraints.items[c];
+        joint->a_index = new_index.items[joint->a_index];
+        joint->b_index = new_index.items[joint->b_index];
+    }
+    broadphase_remap(&world->broadphase, new_index);
+    world->bodies.count = count;
+
+    if (remap != NULL) {
+        DA_FREE(remap);
+        *remap = new_index;
+    } else {
+        DA_FREE(&new_index);
+    }
+}
+
+// the arrays of a snapshot, stored after its header
+typedef enum {
+    SNAPSHOT_BODIES,
+    SNAPSHOT_BODY_GENERATIONS,
+    SNAPSHOT_FREE_BODIES,
+    SNAPSHOT_REMOVED_BODIES,
+    SNAPSHOT_JOINTS,
+    SNAPSHOT_MANIFOLDS,
+    SNAPSHOT_PROXIES,
+    SNAPSHOT_TREE_NODES,
+    SNAPSHOT_ARRAY_COUNT
+} SnapshotArray;
+
+#define SNAPSHOT_ALIGNMENT 16
+
+typedef struct {
+    uint32_t offset; // bytes from the start of the snapshot
+    uint32_t count;
+} SnapshotSection;
+
+typedef struct {
+    SnapshotSection sections[SNAPSHOT_ARRAY_COUNT];
+    int tree_root;
+    int tree_free_list;
+} SnapshotHeader;
+
+typedef struct {
+    void* items;
+    uint32_t count;
+    size_t size;
+} SnapshotSource;
+
+void world_snapshot(World* world, WorldSnapshot* snapshot) {
+    DynamicTree* tree = &world->broadphase.tree;
+    SnapshotSource sources[SNAPSHOT_ARRAY_COUNT] = {
+        [SNAPSHOT_BODIES] = { world->bodies.items, world->bodies.count, sizeof(Body) },
+        [SNAPSHOT_BODY_GENERATIONS] = { world->body_generations.items, world->body_generations.count, sizeof(int) },
+        [SNAPSHOT_FREE_BODIES] = { world->free_bodies.items, world->free_bodies.count, sizeof(int) },
+        [SNAPSHOT_REMOVED_BODIES] = { world->removed_bodies.items, world->removed_bodies.count, sizeof(int) },
+        [SNAPSHOT_JOINTS] = { world->joint_constraints.items, world->joint_constraints.count, sizeof(JointConstraint) },
+        [SNAPSHOT_MANIFOLDS] = { world->manifolds.items, world->manifolds.count, sizeof(Manifold) },
+        [SNAPSHOT_PROXIES] = { world->broadphase.proxies.items, world->broadphase.proxies.count, sizeof(int) },
+        [SNAPSHOT_TREE_NODES] = { tree->nodes.items, tree->nodes.count, sizeof(TreeNode) },
+    };
+    SnapshotHeader header = { .tree_root = tree->root, .tree_free_list = tree->free_list };
+
+    // lay out the arrays first, so that the buffer is grown at most once
+    size_t size = sizeof(header);
+    for (int a = 0; a < SNAPSHOT_ARRAY_COUNT; a++) {
+        size = (size + SNAPSHOT_ALIGNMENT - 1) & ~(size_t) (SNAPSHOT_ALIGNMENT - 1);
+        header.sections[a] = (SnapshotSection) { .offset = (uint32_t) size, .count = sources[a].count };
+        size += sources[a].count * sources[a].size;
+    }
+    if (size > UINT32_MAX) {
+        printf("ERROR: world too big for a snapshot, aborting.\n");
+        exit(1);
+    }
+    DA_RESERVE(snapshot, (uint32_t) size);
+    snapshot->count = (uint32_t) size;
+
+    memcpy(snapshot->items, &header, sizeof(header));
+    for (int a = 0; a < SNAPSHOT_ARRAY_COUNT; a++) {
+        if (sources[a].count > 0)
+            memcpy(snapshot->items + header.sections[a].offset, sources[a].items, sources[a].count * sources[a].size);
+    }
+}
+
+#define SNAPSHOT_RESTORE(xs, snapshot, section)                                                         \
+    do {                                                                                                \
+        DA_RESERVE((xs), (section).count);                                                              \
+        (xs)->count = (section).count;                                                                  \
+        if ((section).count > 0)                                                                        \
+            memcpy((xs)->items, (snapshot)->items + (section).offset, (section).count * sizeof(*(xs)->items)); \
+    } while (0)
+
+void world_restore(World* world, WorldSnapshot* snapshot) {
+    if (snapshot->count < sizeof(SnapshotHeader)) {
+        printf("ERROR: restoring an empty world snapshot, aborting.\n");
+        exit(1);
+    }
+    SnapshotHeader header;
+    memcpy(&header, snapshot->items, sizeof(header));
+    SnapshotSection* sections = header.sections;
+    SNAPSHOT_RESTORE(&world->bodies, snapshot, sections[SNAPSHOT_BODIES]);
+    SNAPSHOT_RESTORE(&world->body_generations, snapshot, sections[SNAPSHOT_BODY_GENERATIONS]);
+    SNAPSHOT_RESTORE(&world->free_bodies, snapshot, sections[SNAPSHOT_FREE_BODIES]);
+    SNAPSHOT_RESTORE(&world->removed_bodies, snapshot, sections[SNAPSHOT_REMOVED_BODIES]);
+    SNAPSHOT_RESTORE(&world->joint_constraints, snapshot, sections[SNAPSHOT_JOINTS]);
+    SNAPSHOT_RESTORE(&world->manifolds, snapshot, sections[SNAPSHOT_MANIFOLDS]);
+    SNAPSHOT_RESTORE(&world->broadphase.proxies, snapshot, sections[SNAPSHOT_PROXIES]);
+    SNAPSHOT_RESTORE(&world->broadphase.tree.nodes, snapshot, sections[SNAPSHOT_TREE_NODES]);
+    world->broadphase.tree.root = header.tree_root;
+    world->broadphase.tree.free_list = header.tree_free_list;
+    // the table is the only part that holds pointers, it is rebuilt from the manifolds
+    world_rebuild_manifold_map(world);
+}
+
+void world_snapshot_free(WorldSnapshot* snapshot) {
+    DA_FREE(snapshot);
+}
+
+void world_reserve(World* world, uint32_t num_bodies, uint32_t num_manifolds) {
+    DA_RESERVE(&world->bodies, num_bodies);
+    DA_RESERVE(&world->body_generations, num_bodies);
+    DA_RESERVE(&world->manifolds, num_manifolds);
+    ht_reserve(&world->manifold_map, num_manifolds);
+}
+
+void world_remove_manifold(World* world, uint32_t index) {
+    Manifold* manifold = &world->manifolds.items[index];
+    ht_remove(&world->manifold_map, (Pair) { .i = manifold->a_index, .j = manifold->b_index });
+    Manifold* last = &world->manifolds.items[--world->manifolds.count];
+    if (manifold != last) {
+        *manifold = *last;
+        ht_set(&world->manifold_map, (Pair) { .i = manifold->a_index, .j = manifold->b_index }, index);
+    }
+}
+
+static Manifold* world_get_or_new_manifold(World* world, Pair pair, uint32_t num_contacts, bool* found) {
+    uint32_t* index = ht_get_or_new(&world->manifold_map, pair, world->manifolds.count, found);
+    if (*found)
+        return &world->manifolds.items[*index];
+    Manifold* manifold = DA_NEXT_PTR(&world->manifolds);
+    manifold_init(manifold, num_contacts, pair.i, pair.j);
+    return manifold;
 }
 
 JointConstraint* world_new_joint(World* world) {
     return DA_NEXT_PTR(&world->joint_constraints);
 }
 
+void world_set_broadphase(World* world, BroadPhaseType type) {
+    world->broadphase.type = type;
+}
+
+void world_set_num_threads(World* world, uint32_t num_threads) {
+    threadpool_free(&world->thread_pool);
+    threadpool_init(&world->thread_pool, num_threads);
+}
+
+void world_set_substeps(World* world, uint32_t substeps) {
+    world->substeps = substeps;
+}
+
+void world_set_simd(World* world, bool enabled) {
+    contact_solver_init(&world->contact_solver, enabled);
+}
+
+// a new world force or torque wakes everything up once, the bodies can go back to sleep under it later
+static void world_wake_bodies(World* world) {
+    for (uint32_t i = 0; i < world->bodies.count; i++) {
+        Body* body = &world->bodies.items[i];
+        if (body->sleeping && !body->removed)
+            body_wake(body);
+    }
+}
+
 void world_add_force(World* world, Vec2 force) {
     DA_APPEND(&world->forces, force);
+    world_wake_bodies(world);
 }
 
 void world_add_torque(World* world, float torque) {
     DA_APPEND(&world->torques, torque);
+    world_wake_bodies(world);
+}
+
+// pairs of bodies that are all sleeping (or static) are not collided
+static bool world_is_pair_asleep(World* world, int a_index, int b_index) {
+    return !body_is_awake(&world->bodies.items[a_index]) && !body_is_awake(&world->bodies.items[b_index]);
+}
+
+typedef struct {
+    World* world;
+    int bullet;
+    Sweep sweep;
+    float time_of_impact; // earliest one so far
+} BulletContext;
+
+static bool world_bullet_query_callback(void* context, int index) {
+    BulletContext* ctx = context;
+    World* world = ctx->world;
+    Body* target = &world->bodies.items[index];
+    // bullets are not swept against each other, the container is handled by the narrow phase
+    bool is_bullet = target->bullet && !body_is_static(target);
+    if (index == ctx->bullet || is_bullet || target->shape.type == SHAPE_CIRCLE_CONTAINER)
+        return true;
+    float t = ccd_time_of_impact(&world->bodies.items[ctx->bullet], &ctx->sweep, target);
+    if (t < ctx->time_of_impact)
+        ctx->time_of_impact = t;
+    return true;
+}
+
+// fast bullets are moved back to their first impact with a static or a non bullet body, that is
+// seen where it ended the step. The next narrow phase then finds the contact they would have skipped
+static void world_solve_bullets(World* world) {
+    for (uint32_t i = 0; i < world->bodies.count; i++) {
+        Body* body = &world->bodies.items[i];
+        if (!body->bullet || !body_is_awake(body) || body->removed || body->shape.type == SHAPE_CIRCLE_CONTAINER)
+            continue;
+        BulletContext ctx = { .world = world, .bullet = i, .sweep = ccd_sweep(body), .time_of_impact = 1.0f };
+        if (!ccd_is_fast(body, &ctx.sweep))
+            continue;
+        broadphase_query(&world->broadphase, world->bodies, ccd_sweep_aabb(body, &ctx.sweep), world_bullet_query_callback, &ctx);
+        if (ctx.time_of_impact < 1.0f) {
+            ccd_move_to(body, &ctx.sweep, ctx.time_of_impact);
+            world->stats.bullets_clamped++;
+        }
+    }
+}
+
+// what a pass of the substep solver does to the constraints or to the bodies of an island
+typedef enum {
+    SUBSTEP_PREPARE, // jacobians of the constraints, once per step
+    SUBSTEP_INTEGRATE_FORCES,
+    SUBSTEP_WARM_START,
+    SUBSTEP_SOLVE, // with the soft bias that pushes the bodies apart
+    SUBSTEP_INTEGRATE_VELOCITIES,
+    SUBSTEP_RELAX, // without the bias, takes back the velocity it added
+    SUBSTEP_RESTITUTION, // once per step
+    SUBSTEP_STORE, // moves the bodies by their displacement, once per step
+} SubstepStage;
+
+typedef struct {
+    World* world;
+    float dt;
+    Island* island; // island being solved by color
+    uint32_t color;
+    uint32_t batch_offset; // first batch of the color in the world's contact rows
+    // substep solver
+    SubstepStage stage; // of the island solved by color
+    float h; // duration of a substep
+    float inv_h;
+    Softness contact_softness;
+    Softness joint_softness;
+} SolveContext;
+
+// adds the time since start to a solver phase and restarts the clock, islands and batches call it from several threads
+static void world_add_phase_time(World* world, SolverPhase phase, uint64_t* start) {
+    uint64_t now = time_now_ns();
+    __atomic_fetch_add(&world->solver_phase_ns[phase], now - *start, __ATOMIC_RELAXED);
+    *start = now;
+}
+
+static double world_elapsed_ms(uint64_t* start) {
+    uint64_t now = time_now_ns();
+    double elapsed = (double) (now - *start) * 1e-6;
+    *start = now;
+    return elapsed;
+}
+
+static bool world_is_island_colored(Island* island) {
+    return island->joint_count + island->manifold_count >= GRAPH_MIN_CONSTRAINTS;
+}
+
+static uint32_t world_num_batches(uint32_t count) {
+    return (count + GRAPH_BATCH_SIZE - 1) / GRAPH_BATCH_SIZE;
+}
+
+static void world_init_substeps(SolveContext* ctx) {
+    ctx->h = ctx->dt / (float) ctx->world->substeps;
+    ctx->inv_h = 1.0f / ctx->h;
+    float contact_hertz = fminf(SUBSTEP_CONTACT_HERTZ, 0.25f * ctx->inv_h);
+    ctx->contact_softness = constraint_softness(contact_hertz, SUBSTEP_CONTACT_DAMPING_RATIO, ctx->h);
+    ctx->joint_softness = constraint_softness(2.0f * contact_hertz, SUBSTEP_JOINT_DAMPING_RATIO, ctx->h);
+}
+
+static bool world_is_body_stage(SubstepStage stage) {
+    return stage == SUBSTEP_INTEGRATE_FORCES || stage == SUBSTEP_INTEGRATE_VELOCITIES || stage == SUBSTEP_STORE;
+}
+
+// joints and manifolds are prepared together, their time goes to the manifold pre-solve
+static SolverPhase world_substep_phase(SubstepStage stage) {
+    if (stage == SUBSTEP_PREPARE)
+        return SOLVER_PHASE_MANIFOLD_PRE_SOLVE;
+    return world_is_body_stage(stage) ? SOLVER_PHASE_INTEGRATE_VELOCITIES : SOLVER_PHASE_SOLVE;
+}
+
+// constraint k of the island, joints come first and then manifolds
+static void world_substep_constraint(SolveContext* ctx, Island* island, uint32_t k, SubstepStage stage) {
+    World* world = ctx->world;
+    SolverBodyArray* solver_bodies = &world->solver_bodies;
+    if (k < island->joint_count) {
+        JointConstraint* joint = &world->joint_constraints.items[world->islands.joints.items[island->joint_start + k]];
+        if (stage == SUBSTEP_PREPARE)
+            constraint_joint_prepare(joint, &world->bodies.items[joint->a_index], &world->bodies.items[joint->b_index], solver_bodies);
+        else if (stage == SUBSTEP_WARM_START)
+            constraint_joint_warm_start(joint, solver_bodies);
+        else if (stage == SUBSTEP_SOLVE || stage == SUBSTEP_RELAX)
+            constraint_joint_solve_soft(joint, solver_bodies, &ctx->joint_softness, stage == SUBSTEP_SOLVE);
+        return;
+    }
+    Manifold* manifold = &world->manifolds.items[world->islands.manifolds.items[island->manifold_start + k - island->joint_count]];
+    if (stage == SUBSTEP_PREPARE)
+        manifold_prepare(manifold, world->bodies, solver_bodies);
+    else if (stage == SUBSTEP_WARM_START)
+        manifold_warm_start(manifold, solver_bodies);
+    else if (stage == SUBSTEP_SOLVE || stage == SUBSTEP_RELAX)
+        manifold_solve_soft(manifold, solver_bodies, &ctx->contact_softness, ctx->inv_h, stage == SUBSTEP_SOLVE);
+    else if (stage == SUBSTEP_RESTITUTION)
+        manifold_restitution(manifold, solver_bodies);
+}
+
+static void world_substep_body(SolveContext* ctx, uint32_t index, SubstepStage stage) {
+    World* world = ctx->world;
+    SolverBodyArray* solver_bodies = &world->solver_bodies;
+    if (stage == SUBSTEP_INTEGRATE_FORCES) {
+        solver_bodies_integrate_forces(solver_bodies, index, ctx->h);
+    } else if (stage == SUBSTEP_INTEGRATE_VELOCITIES) {
+        solver_bodies_integrate_velocities(solver_bodies, index, ctx->h);
+    } else if (stage == SUBSTEP_STORE) {
+        Body* body = &world->bodies.items[index];
+        solver_bodies_store(solver_bodies, index, body);
+        body_integrate_displacement(body, VEC2(solver_bodies->dx[index], solver_bodies->dy[index]), solver_bodies->dq[index]);
+        body_update_sleep_time(body, ctx->dt);
+    }
+}
+
+static void world_substep_constraints_batch(void* context, uint32_t batch) {
+    SolveContext* ctx = context;
+    ConstraintGraph* graph = &ctx->world->graph;
+    uint32_t start = graph->color_start[ctx->color] + batch * GRAPH_BATCH_SIZE;
+    uint32_t end = start + GRAPH_BATCH_SIZE;
+    if (end > graph->color_start[ctx->color + 1])
+        end = graph->color_start[ctx->color + 1];
+    uint64_t time = time_now_ns();
+    for (uint32_t c = start; c < end; c++) {
+        world_substep_constraint(ctx, ctx->island, graph->constraints.items[c], ctx->stage);
+    }
+    world_add_phase_time(ctx->world, world_substep_phase(ctx->stage), &time);
+}
+
+static void world_substep_bodies_batch(void* context, uint32_t batch) {
+    SolveContext* ctx = context;
+    Island* island = ctx->island;
+    int* bodies = &ctx->world->islands.bodies.items[island->body_start];
+    uint32_t start = batch * GRAPH_BATCH_SIZE;
+    uint32_t end = start + GRAPH_BATCH_SIZE;
+    if (end > island->body_count)
+        end = island->body_count;
+    uint64_t time = time_now_ns();
+    for (uint32_t b = start; b < end; b++) {
+        world_substep_body(ctx, (uint32_t) bodies[b], ctx->stage);
+    }
+    world_add_phase_time(ctx->world, world_substep_phase(ctx->stage), &time);
+}
+
+// small islands run a stage on the calling thread, without touching the context that the other islands share.
+// Big islands run it one color at a time like world_solve_island_colored, with their own context
+static void world_substep_stage(SolveContext* ctx, Island* island, SubstepStage stage) {
+    World* world = ctx->world;
+    if (!world_is_island_colored(island)) {
+        uint64_t time = time_now_ns();
+        if (world_is_body_stage(stage)) {
+            int* bodies = &world->islands.bodies.items[island->body_start];
+            for (uint32_t b = 0; b < island->body_count; b++) {
+                world_substep_body(ctx, (uint32_t) bodies[b], stage);
+            }
+        } else {
+            for (uint32_t k = 0; k < island->joint_count + island->manifold_count; k++) {
+                world_substep_constraint(ctx, island, k, stage);
+            }
+        }
+        world_add_phase_time(world, world_substep_phase(stage), &time);
+        return;
+    }
+
+    ConstraintGraph* graph = &world->graph;
+    ctx->stage = stage;
+    if (world_is_body_stage(stage)) {
+        threadpool_run(&world->thread_pool, world_num_batches(island->body_count), world_substep_bodies_batch, ctx);
+        return;
+    }
+    for (uint32_t color = 0; color < graph->num_colors; color++) {
+        ctx->color = color;
+        threadpool_run(&world->thread_pool, world_num_batches(graph_color_count(graph, color)), world_substep_constraints_batch, ctx);
+    }
+    // the overflow constraints share bodies, they are solved serially
+    ctx->color = GRAPH_OVERFLOW_COLOR;
+    for (uint32_t b = 0; b < world_num_batches(graph_color_count(graph, GRAPH_OVERFLOW_COLOR)); b++) {
+        world_substep_constraints_batch(ctx, b);
+    }
+}
+
+// the jacobians are computed once, then every substep adds the forces, solves each constraint once with its
+// soft bias, moves the bodies and relaxes the constraints. The contacts only update their separation from
+// the displacement of the bodies, the contact points stay the ones found at the start of the step
+static void world_substep_island(SolveContext* ctx, Island* island) {
+    world_substep_stage(ctx, island, SUBSTEP_PREPARE);
+    for (uint32_t i = 0; i < ctx->world->substeps; i++) {
+        world_substep_stage(ctx, island, SUBSTEP_INTEGRATE_FORCES);
+        world_substep_stage(ctx, island, SUBSTEP_WARM_START);
+        world_substep_stage(ctx, island, SUBSTEP_SOLVE);
+        world_substep_stage(ctx, island, SUBSTEP_INTEGRATE_VELOCITIES);
+        world_substep_stage(ctx, island, SUBSTEP_RELAX);
+    }
+    world_substep_stage(ctx, island, SUBSTEP_RESTITUTION);
+    world_substep_stage(ctx, island, SUBSTEP_STORE);
+}
+
+// pre-solve, solve and integrate the bodies of a single island
+static void world_solve_island(void* context, uint32_t island_index) {
+    SolveContext* ctx = context;
+    World* world = ctx->world;
+    IslandSet* islands = &world->islands;
+    Island* island = &islands->islands.items[island_index];
+    if (island->sleeping || world_is_island_colored(island))
+        return;
+    if (world->substeps > 0) {
+        world_substep_island(ctx, island);
+        return;
+    }
+    int* joints = &islands->joints.items[island->joint_start];
+    int* manifolds = &islands->manifolds.items[island->manifold_start];
+    Manifold* island_manifolds = world->manifolds.items;
+    uint64_t start = time_now_ns();
+
+    for (uint32_t c = 0; c < island->joint_count; c++) {
+        JointConstraint* constraint = &world->joint_constraints.items[joints[c]];
+        Body* a = &world->bodies.items[constraint->a_index];
+        Body* b = &world->bodies.items[constraint->b_index];
+        constraint_joint_pre_solve(constraint, a, b, &world->solver_bodies, ctx->dt);
+    }
+    world_add_phase_time(world, SOLVER_PHASE_JOINT_PRE_SOLVE, &start);
+    for (uint32_t c = 0; c < island->manifold_count; c++) {
+        manifold_pre_solve(&island_manifolds[manifolds[c]], world->bodies, &world->solver_bodies, ctx->dt);
+    }
+    world_add_phase_time(world, SOLVER_PHASE_MANIFOLD_PRE_SOLVE, &start);
+
+    for (uint32_t i = 0; i < SOLVE_ITERATIONS; i++) {
+        // joints
+        for (uint32_t c = 0; c < island->joint_count; c++) {
+            JointConstraint* constraint = &world->joint_constraints.items[joints[c]];
+            constraint_joint_solve(constraint, &world->solver_bodies);
+        }
+        // penetrations
+        for (uint32_t c = 0; c < island->manifold_count; c++) {
+            manifold_solve(&island_manifolds[manifolds[c]], &world->solver_bodies);
+        }
+    }
+    world_add_phase_time(world, SOLVER_PHASE_SOLVE, &start);
+
+    // integrate all velocities
+    for (uint32_t b = 0; b < island->body_count; b++) {
+        uint32_t index = (uint32_t) islands->bodies.items[island->body_start + b];
+        Body* body = &world->bodies.items[index];
+        solver_bodies_store(&world->solver_bodies, index, body);
+        body_integrate_velocities(body, ctx->dt);
+        body_update_sleep_time(body, ctx->dt);
+    }
+    world_add_phase_time(world, SOLVER_PHASE_INTEGRATE_VELOCITIES, &start);
+}
+
+// constraint k of the island being solved, joints come first and then manifolds
+static void world_pre_solve_constraint(World* world, Island* island, uint32_t k, float dt) {
+    if (k < island->joint_count) {
+        JointConstraint* constraint = &world->joint_constraints.items[world->islands.joints.items[island->joint_start + k]];
+        Body* a = &world->bodies.items[constraint->a_index];
+        Body* b = &world->bodies.items[constraint->b_index];
+        constraint_joint_pre_solve(constraint, a, b, &world->solver_bodies, dt);
+    } else {
+        int manifold = world->islands.manifolds.items[island->manifold_start + k - island->joint_count];
+        manifold_pre_solve(&world->manifolds.items[manifold], world->bodies, &world->solver_bodies, dt);
+    }
+}
+
+static void world_solve_constraint(World* world, Island* island, uint32_t k) {
+    if (k < island->joint_count) {
+        JointConstraint* constraint = &world->joint_constraints.items[world->islands.joints.items[island->joint_start + k]];
+        constraint_joint_solve(constraint, &world->solver_bodies);
+    } else {
+        int manifold = world->islands.manifolds.items[island->manifold_start + k - island->joint_count];
+        manifold_solve(&world->manifolds.items[manifold], &world->solver_bodies);
+    }
+}
+
+// the contacts of a color batch are solved with simd, except for the overflow color whose constraints share bodies
+static bool world_is_batch_wide(SolveContext* ctx) {
+    return ctx->world->contact_solver.solve != NULL && ctx->color != GRAPH_OVERFLOW_COLOR;
+}
+
+static ContactRow* world_batch_rows(SolveContext* ctx, uint32_t batch) {
+    ContactSolver* solver = &ctx->world->contact_solver;
+    return &ctx->world->contact_rows.items[(ctx->batch_offset + batch) * contact_solver_max_rows(solver, GRAPH_BATCH_SIZE)];
+}
+
+static void world_pre_solve_batch(void* context, uint32_t batch) {
+    SolveContext* ctx = context;
+    World* world = ctx->world;
+    Island* island = ctx->island;
+    ConstraintGraph* graph = &world->graph;
+    uint32_t start = graph->color_start[ctx->color] + batch * GRAPH_BATCH_SIZE;
+    uint32_t end = start + GRAPH_BATCH_SIZE;
+    if (end > graph->color_start[ctx->color + 1])
+        end = graph->color_start[ctx->color + 1];
+    // constraints of the same color don't share bodies, joints and manifolds are pre-solved apart to time them
+    uint64_t time = time_now_ns();
+    for (uint32_t c = start; c < end; c++) {
+        uint32_t k = graph->constraints.items[c];
+        if (k < island->joint_count)
+            world_pre_solve_constraint(world, island, k, ctx->dt);
+    }
+    world_add_phase_time(world, SOLVER_PHASE_JOINT_PRE_SOLVE, &time);
+    for (uint32_t c = start; c < end; c++) {
+        uint32_t k = graph->constraints.items[c];
+        if (k >= island->joint_count)
+            world_pre_solve_constraint(world, island, k, ctx->dt);
+    }
+    if (!world_is_batch_wide(ctx)) {
+        world_add_phase_time(world, SOLVER_PHASE_MANIFOLD_PRE_SOLVE, &time);
+        return;
+    }
+
+    Manifold* manifolds[GRAPH_BATCH_SIZE];
+    uint32_t num_manifolds = 0;
+    for (uint32_t c = start; c < end; c++) {
+        uint32_t k = graph->constraints.items[c];
+        if (k < island->joint_count)
+            continue;
+        int manifold = world->islands.manifolds.items[island->manifold_start + k - island->joint_count];
+        manifolds[num_manifolds++] = &world->manifolds.items[manifold];
+    }
+    world->contact_row_counts.items[ctx->batch_offset + batch] = contact_solver_pack(
+        &world->contact_solver, world_batch_rows(ctx, batch), manifolds, num_manifolds, &world->solver_bodies);
+    world_add_phase_time(world, SOLVER_PHASE_MANIFOLD_PRE_SOLVE, &time);
+}
+
+static void world_solve_batch(void* context, uint32_t batch) {
+    SolveContext* ctx = context;
+    World* world = ctx->world;
+    ConstraintGraph* graph = &world->graph;
+    uint32_t start = graph->color_start[ctx->color] + batch * GRAPH_BATCH_SIZE;
+    uint32_t end = start + GRAPH_BATCH_SIZE;
+    if (end > graph->color_start[ctx->color + 1])
+        end = graph->color_start[ctx->color + 1];
+    uint64_t time = time_now_ns();
+    if (!world_is_batch_wide(ctx)) {
+        for (uint32_t c = start; c < end; c++) {
+            world_solve_constraint(world, ctx->island, graph->constraints.items[c]);
+        }
+        world_add_phase_time(world, SOLVER_PHASE_SOLVE, &time);
+        return;
+    }
+
+    // constraints of the same color don't share bodies, so the order between joints and contacts doesn't matter
+    for (uint32_t c = start; c < end; c++) {
+        uint32_t k = graph->constraints.items[c];
+        if (k < ctx->island->joint_count)
+            world_solve_constraint(world, ctx->island, k);
+    }
+    uint32_t num_rows = world->contact_row_counts.items[ctx->batch_offset + batch];
+    world->contact_solver.solve(world_batch_rows(ctx, batch), num_rows, &world->solver_bodies);
+    world_add_phase_time(world, SOLVER_PHASE_SOLVE, &time);
+}
+
+static void world_store_batch(void* context, uint32_t batch) {
+    SolveContext* ctx = context;
+    World* world = ctx->world;
+    uint32_t num_rows = world->contact_row_counts.items[batch];
+    uint64_t time = time_now_ns();
+    contact_solver_store(&world->contact_solver, world_batch_rows(ctx, batch), num_rows);
+    world_add_phase_time(world, SOLVER_PHASE_SOLVE, &time);
+}
+
+static void world_integrate_batch(void* context, uint32_t batch) {
+    SolveContext* ctx = context;
+    Island* island = ctx->island;
+    int* bodies = &ctx->world->islands.bodies.items[island->body_start];
+    uint32_t start = batch * GRAPH_BATCH_SIZE;
+    uint32_t end = start + GRAPH_BATCH_SIZE;
+    if (end > island->body_count)
+        end = island->body_count;
+    uint64_t time = time_now_ns();
+    for (uint32_t b = start; b < end; b++) {
+        Body* body = &ctx->world->bodies.items[bodies[b]];
+        solver_bodies_store(&ctx->world->solver_bodies, (uint32_t) bodies[b], body);
+        body_integrate_velocities(body, ctx->dt);
+        body_update_sleep_time(body, ctx->dt);
+    }
+    world_add_phase_time(ctx->world, SOLVER_PHASE_INTEGRATE_VELOCITIES, &time);
+}
+
+// only the bodies that moved in this step are transformed, static and resting ones keep their vertices
+static void world_update_vertices_batch(void* context, uint32_t batch) {
+    SolveContext* ctx = context;
+    BodyArray* bodies = &ctx->world->bodies;
+    uint32_t start = batch * VERTICES_BATCH_SIZE;
+    uint32_t end = start + VERTICES_BATCH_SIZE;
+    if (end > bodies->count)
+        end = bodies->count;
+    for (uint32_t i = start; i < end; i++) {
+        Body* body = &bodies->items[i];
+        if (!body->removed && !body->sleeping)
+            body_update_vertices(body);
+    }
+}
+
+// big islands are solved one at a time, the constraints of each color in parallel.
+// The result doesn't depend on the number of threads since constraints of the same
+// color don't share any body
+static void world_solve_island_colored(World* world, Island* island, float dt) {
+    ConstraintGraph* graph = &world->graph;
+    graph_color(graph, world, island);
+    if (world->substeps > 0) {
+        SolveContext ctx = { .world = world, .dt = dt, .island = island };
+        world_init_substeps(&ctx);
+        world_substep_island(&ctx, island);
+        return;
+    }
+
+    // every batch gets room for its contact rows, the colors are laid out one after the other
+    uint32_t batch_offsets[GRAPH_MAX_COLORS + 1];
+    batch_offsets[0] = 0;
+    for (uint32_t color = 0; color < graph->num_colors; color++) {
+        batch_offsets[color + 1] = batch_offsets[color] + world_num_batches(graph_color_count(graph, color));
+    }
+    uint32_t num_batches = batch_offsets[graph->num_colors];
+    if (world->contact_solver.solve != NULL) {
+        DA_RESERVE(&world->contact_rows, num_batches * contact_solver_max_rows(&world->contact_solver, GRAPH_BATCH_SIZE));
+        DA_RESERVE(&world->contact_row_counts, num_batches);
+    }
+
+    SolveContext ctx = { .world = world, .dt = dt, .island = island };
+    for (uint32_t color = 0; color < graph->num_colors; color++) {
+        ctx.color = color;
+        ctx.batch_offset = batch_offsets[color];
+        threadpool_run(&world->thread_pool, world_num_batches(graph_color_count(graph, color)), world_pre_solve_batch, &ctx);
+    }
+    // the overflow constraints share bodies, they are solved serially
+    ctx.color = GRAPH_OVERFLOW_COLOR;
+    for (uint32_t b = 0; b < world_num_batches(graph_color_count(graph, GRAPH_OVERFLOW_COLOR)); b++) {
+        world_pre_solve_batch(&ctx, b);
+    }
+
+    for (uint32_t i = 0; i < SOLVE_ITERATIONS; i++) {
+        for (uint32_t color = 0; color < graph->num_colors; color++) {
+            ctx.color = color;
+            ctx.batch_offset = batch_offsets[color];
+            threadpool_run(&world->thread_pool, world_num_batches(graph_color_count(graph, color)), world_solve_batch, &ctx);
+        }
+        ctx.color = GRAPH_OVERFLOW_COLOR;
+        for (uint32_t b = 0; b < world_num_batches(graph_color_count(graph, GRAPH_OVERFLOW_COLOR)); b++) {
+            world_solve_batch(&ctx, b);
+        }
+    }
+
+    if (world->contact_solver.solve != NULL) {
+        ctx.batch_offset = 0;
+        threadpool_run(&world->thread_pool, num_batches, world_store_batch, &ctx);
+    }
+    threadpool_run(&world->thread_pool, world_num_batches(island->body_count), world_integrate_batch, &ctx);
+}
+
+static void world_collide_pair(World* world, Pair pair, PairContacts* result) {
+    result->tested = true;
+    result->num_contacts = 0;
+    result->colliding = collision_iscolliding(&world->bodies.items[pair.i], &world->bodies.items[pair.j],
+        result->contacts, &result->num_contacts);
+}
+
+// each task writes only the results of its own pairs, nothing else in the world is touched
+static void world_collide_batch(void* context, uint32_t batch) {
+    World* world = ((SolveContext*) context)->world;
+    uint32_t start = batch * NARROW_PHASE_BATCH_SIZE;
+    uint32_t end = start + NARROW_PHASE_BATCH_SIZE;
+    if (end > world->broadphase.pairs.count)
+        end = world->broadphase.pairs.count;
+    for (uint32_t p = start; p < end; p++) {
+        Pair pair = world->broadphase.pairs.items[p];
+        PairContacts* result = &world->pair_contacts.items[p];
+        if (world_is_pair_asleep(world, pair.i, pair.j))
+            result->tested = false;
+        else
+            world_collide_pair(world, pair, result);
+    }
 }
 
 void world_update(World* world, float dt) {
+    WorldStats* stats = &world->stats;
+    *stats = (WorldStats) { 0 };
+    for (int phase = 0; phase < SOLVER_PHASE_COUNT; phase++) {
+        world->solver_phase_ns[phase] = 0;
+    }
+    ht_reset_stats(&world->manifold_map);
+    uint64_t start = time_now_ns();
+    uint64_t time = start;
+
+    world_drop_removed_constraints(world);
+
     // apply all the forces
     for (uint32_t i = 0; i < world->bodies.count; i++) {
         Body* body = &world->bodies.items[i];
+        if (body->sleeping || body->removed)
+            continue;
 
         // add weight force
         Vec2 weight = VEC2(0.0,  world->gravity / body->inv_mass);
@@ -66,81 +892,128 @@ void world_update(World* world, float dt) {
         }
     }
 
+    stats->time_forces = world_elapsed_ms(&time);
+
     // integrate all the forces
     for (uint32_t i = 0; i < world->bodies.count; i++) {
         Body* body = &world->bodies.items[i];
+        if (body->sleeping || body->removed)
+            continue;
         body_integrate_forces(body, dt);
     }
 
-    // check collisions
-    for (uint32_t i = 0; i < world->bodies.count - 1; i++) {
-        for (uint32_t j = i + 1; j < world->bodies.count; j++) {
-            Body* a = &world->bodies.items[i];
-            Body* b = &world->bodies.items[j];
-            Contact contacts[2];
-            uint32_t num_contacts = 0;
-            if (collision_iscolliding(a, b, contacts, &num_contacts)) {
-                // find if there is already an existing manifold between A and B
-                bool persistent[2] = { false };
-                bool found = false;
-                Manifold* manifold = ht_get_or_new(&world->manifold_map, (Pair){i, j}, num_contacts, &found);
-                manifold->expired = false;
-                if (found) {
-                    // manifold exists, check persistent contacts
-                    if (world->warm_start) {
-                        for (uint32_t c = 0; c < num_contacts; c++) {
-                            persistent[c] = manifold_find_existing_contact(manifold, &contacts[c]);
-                        }
-                    }
-                } 
+    stats->time_integrate_forces = world_elapsed_ms(&time);
+
+    // broad phase: only the pairs whose fat aabbs overlap reach the narrow phase
+    broadphase_update(&world->broadphase, world->bodies, dt);
+
+    // narrow phase, in parallel
+    PairArray* pairs = &world->broadphase.pairs;
+    DA_RESERVE(&world->pair_contacts, pairs->count);
+    world->pair_contacts.count = pairs->count;
+    SolveContext collide_context = { .world = world, .dt = dt };
+    uint32_t collide_batches = (pairs->count + NARROW_PHASE_BATCH_SIZE - 1) / NARROW_PHASE_BATCH_SIZE;
+    threadpool_run(&world->thread_pool, collide_batches, world_collide_batch, &collide_context);
+
+    // the results are merged in the order of the pairs, which doesn't depend on the number of threads,
+    // so the manifolds are created and matched exactly as if the pairs had been collided one by one
+    for (uint32_t p = 0; p < pairs->count; p++) {
+        Pair pair = pairs->items[p];
+        Body* a = &world->bodies.items[pair.i];
+        Body* b = &world->bodies.items[pair.j];
+        PairContacts* result = &world->pair_contacts.items[p];
+        if (!result->tested) {
+            // a new contact earlier in the merge can wake up a pair that was asleep
+            if (world_is_pair_asleep(world, pair.i, pair.j))
+                continue;
+            world_collide_pair(world, pair, result);
+        }
+        stats->pairs_tested++;
+        if (!result->colliding)
+            continue;
+        Contact* contacts = result->contacts;
+        uint32_t num_contacts = result->num_contacts;
+        stats->pairs_colliding++;
+        stats->contacts_created += num_contacts;
+        // find if there is already an existing manifold between A and B
+        bool persistent[2] = { false };
+        bool found = false;
+        Manifold* manifold = world_get_or_new_manifold(world, pair, num_contacts, &found);
+        manifold->expired = false;
+        if (found) {
+            // manifold exists, check persistent contacts
+            if (world->warm_start) {
                 for (uint32_t c = 0; c < num_contacts; c++) {
-                    // contact->end is pa, contact->start is pb, normal is from A to B
-                    constraint_penetration_init(
-                        &manifold->constraints[c], contacts[c].end, contacts[c].start, contacts[c].normal, persistent[c]);
+                    persistent[c] = manifold_find_existing_contact(manifold, &contacts[c]);
+                    stats->warm_start_hits += persistent[c];
                 }
-                manifold->num_contacts = num_contacts;
-            } 
+            }
+        } else {
+            // a new contact wakes up a sleeping body
+            if (a->sleeping)
+                body_wake(a);
+            if (b->sleeping)
+                body_wake(b);
         }
+        for (uint32_t c = 0; c < num_contacts; c++) {
+            // contact->end is pa, contact->start is pb, normal is from A to B
+            constraint_penetration_init(
+                &manifold->constraints[c], contacts[c].end, contacts[c].start, contacts[c].normal, persistent[c]);
+        }
+        manifold->num_contacts = num_contacts;
     }
+    stats->time_collision = world_elapsed_ms(&time);
 
-    for (uint32_t c = 0; c < world->joint_constraints.count; c++) {
-        JointConstraint* constraint = &world->joint_constraints.items[c];
-        Body* a = &world->bodies.items[constraint->a_index];
-        Body* b = &world->bodies.items[constraint->b_index];
-        constraint_joint_pre_solve(constraint, a, b, dt);
-    }
+    // islands that have been still for long enough go to sleep, the others are woken up
+    island_build(&world->islands, world);
+    island_update_sleep(&world->islands, world);
 
-    for (uint32_t c = 0; c < world->manifold_map.capacity; c++) {
-        Bucket* bucket = &world->manifold_map.buckets[c];
-        if (bucket->occupied) {
-            if (!bucket->value.expired) {
-                manifold_pre_solve(&world->manifold_map.buckets[c].value, world->bodies, dt);
-                bucket->value.expired = true;
-            } else {
-                ht_remove_bucket(bucket);
-            }
-        } 
+    stats->manifolds_expired = island_collect_constraints(&world->islands, world);
+
+    // the solver works on packed copies of the velocities, they are written back before integrating
+    solver_bodies_resize(&world->solver_bodies, world->bodies.count);
+    for (uint32_t i = 0; i < world->bodies.count; i++) {
+        if (world->substeps > 0)
+            solver_bodies_load_substeps(&world->solver_bodies, i, &world->bodies.items[i], dt);
+        else
+            solver_bodies_load(&world->solver_bodies, i, &world->bodies.items[i]);
     }
-    for (uint32_t i = 0; i < SOLVE_ITERATIONS; i++) {
-        // joints
-        for (uint32_t c = 0; c < world->joint_constraints.count; c++) {
-            JointConstraint* constraint = &world->joint_constraints.items[c];
-            Body* a = &world->bodies.items[constraint->a_index];
-            Body* b = &world->bodies.items[constraint->b_index];
-            constraint_joint_solve(constraint, a, b);
-        }
-        // penetrations
-        for (uint32_t c = 0; c < world->manifold_map.capacity; c++) {
-            if (world->manifold_map.buckets[c].occupied) {
-                manifold_solve(&world->manifold_map.buckets[c].value, world->bodies);
-            }
-        }
+    stats->time_islands = world_elapsed_ms(&time);
+
+    // big islands are split in colors that are solved in parallel
+    for (uint32_t k = 0; k < world->islands.islands.count; k++) {
+        Island* island = &world->islands.islands.items[k];
+        if (!island->sleeping && world_is_island_colored(island))
+            world_solve_island_colored(world, island, dt);
     }
 
-    // integrate all velocities
+    // islands don't share any non static body, so the other ones can be solved in parallel
+    SolveContext context = { .world = world, .dt = dt };
+    if (world->substeps > 0)
+        world_init_substeps(&context);
+    threadpool_run(&world->thread_pool, world->islands.islands.count, world_solve_island, &context);
+
+    // static bodies can touch many islands, they are integrated once all the islands are done
+    time = time_now_ns();
     for (uint32_t i = 0; i < world->bodies.count; i++) {
         Body* body = &world->bodies.items[i];
-        body_integrate_velocities(body, dt);
+        if (body_is_static(body) && !body->removed)
+            body_integrate_velocities(body, dt);
     }
+    uint32_t vertex_batches = (world->bodies.count + VERTICES_BATCH_SIZE - 1) / VERTICES_BATCH_SIZE;
+    threadpool_run(&world->thread_pool, vertex_batches, world_update_vertices_batch, &context);
+    world_add_phase_time(world, SOLVER_PHASE_INTEGRATE_VELOCITIES, &time);
+
+    world_solve_bullets(world);
+    stats->time_ccd = world_elapsed_ms(&time);
+
+    stats->time_joint_pre_solve = (double) world->solver_phase_ns[SOLVER_PHASE_JOINT_PRE_SOLVE] * 1e-6;
+    stats->time_manifold_pre_solve = (double) world->solver_phase_ns[SOLVER_PHASE_MANIFOLD_PRE_SOLVE] * 1e-6;
+    stats->time_solve = (double) world->solver_phase_ns[SOLVER_PHASE_SOLVE] * 1e-6;
+    stats->time_integrate_velocities = (double) world->solver_phase_ns[SOLVER_PHASE_INTEGRATE_VELOCITIES] * 1e-6;
+    stats->time_total = world_elapsed_ms(&start);
+    stats->manifold_lookups = world->manifold_map.lookups;
+    stats->manifold_probes = world->manifold_map.probes;
+    stats->manifold_max_probe = world->manifold_map.max_probe;
 }
 
@@ -3,25 +3,125 @@
 
 #include "body.h"
 #include "array.h"
+#include "broadphase.h"
+#include "collision.h"
 #include "constraint.h"
+#include "contact_solver.h"
+#include "graph.h"
+#include "island.h"
 #include "manifold.h"
 #include "memory.h"
+#include "solver.h"
 #include "table.h"
+#include "threadpool.h"
+
+// what happened during the last world_update, times are in milliseconds.
+// The islands are solved in parallel, so the time of the solver phases is summed over the threads
+typedef struct {
+    double time_forces;
+    double time_integrate_forces;
+    double time_collision; // broad phase and narrow phase
+    double time_islands; // building the islands, sleeping and collecting their constraints
+    double time_joint_pre_solve;
+    double time_manifold_pre_solve;
+    double time_solve; // solver iterations
+    double time_integrate_velocities;
+    double time_ccd; // sweeping the bullets
+    double time_total;
+    uint32_t pairs_tested; // pairs that reached the narrow phase
+    uint32_t pairs_colliding;
+    uint32_t contacts_created;
+    uint32_t warm_start_hits; // contacts that matched one of the previous step
+    uint32_t manifolds_expired;
+    uint32_t bullets_clamped; // bullets moved back to their time of impact
+    uint32_t manifold_lookups;
+    uint32_t manifold_probes; // slots visited by all the lookups in manifold_map
+    uint32_t manifold_max_probe;
+} WorldStats;
+
+// refers to a body across removals: the generation of a slot changes every time its body is removed or moved
+typedef struct {
+    uint32_t index;
+    uint32_t generation;
+} BodyHandle;
+
+// the simulation state of a world in one flat buffer: a header with the offset of each array followed by
+// the arrays, without any pointer, so it can be copied or sent as it is
+typedef struct {
+    uint32_t capacity;
+    uint32_t count; // bytes
+    uint8_t* items;
+} WorldSnapshot;
+
+typedef enum {
+    SOLVER_PHASE_JOINT_PRE_SOLVE,
+    SOLVER_PHASE_MANIFOLD_PRE_SOLVE,
+    SOLVER_PHASE_SOLVE,
+    SOLVER_PHASE_INTEGRATE_VELOCITIES,
+    SOLVER_PHASE_COUNT
+} SolverPhase;
 
 typedef struct World {
     BodyArray bodies;
+    IntArray body_generations; // of each body slot
+    IntArray free_bodies; // slots that new bodies can reuse
+    IntArray removed_bodies; // removed since the last update, they are freed once their constraints are dropped
     JointConstraintArray joint_constraints;
-    Table manifold_map;
+    ManifoldArray manifolds; // live manifolds, packed
+    Table manifold_map; // pair of bodies -> index in manifolds
+    BroadPhase broadphase;
+    PairContactsArray pair_contacts; // narrow phase result of each broad phase pair
+    IslandSet islands;
+    ConstraintGraph graph;
+    SolverBodyArray solver_bodies; // velocities read and written by the constraint solver
+    ContactSolver contact_solver; // simd contact solver used for the colors of big islands
+    ContactRowArray contact_rows; // contacts of each color batch, packed for the simd solver
+    IntArray contact_row_counts; // rows used by each color batch
+    ThreadPool thread_pool;
     Vec2Array forces;
     FloatArray torques;
+    WorldStats stats;
+    uint64_t solver_phase_ns[SOLVER_PHASE_COUNT]; // added up by the threads solving the islands
     float gravity;
+    uint32_t substeps; // 0 for the baumgarte solver, see world_set_substeps
     bool warm_start;
+    bool allow_sleep;
 } World;
 
 void world_init(World* world, float gravity);
 void world_free(World* world);
+// reuses the slot of a removed body if there is one
 Body* world_new_body(World* world);
+BodyHandle world_body_handle(World* world, Body* body);
+// NULL if the body has been removed
+Body* world_get_body(World* world, BodyHandle handle);
+// the manifolds and joints of the body are dropped at the start of the next update, waking up the bodies
+// they touched. Returns false if the handle is stale
+bool world_remove_body(World* world, BodyHandle handle);
+// moves the bodies down over the slots of the removed ones, keeping their order, and remaps the indices of
+// the manifolds, the joints and the broad phase. If remap is not NULL it gets the new index of each old slot,
+// -1 for the removed ones. The handles of the moved bodies become stale
+void world_compact(World* world, IntArray* remap);
+// copies the bodies, the joints, the manifolds with their accumulated impulses and the broad phase tree
+// into the snapshot, reusing its memory. Gravity, forces and settings are not part of it
+void world_snapshot(World* world, WorldSnapshot* snapshot);
+// puts the world back in the state of the snapshot, the next updates are the same as the ones after it was taken
+void world_restore(World* world, WorldSnapshot* snapshot);
+void world_snapshot_free(WorldSnapshot* snapshot);
 JointConstraint* world_new_joint(World* world);
+// presizes the bodies and the manifolds for a scene, call it before adding bodies since they can move
+void world_reserve(World* world, uint32_t num_bodies, uint32_t num_manifolds);
+// the last manifold takes the place of the removed one
+void world_remove_manifold(World* world, uint32_t index);
+void world_set_broadphase(World* world, BroadPhaseType type);
+// number of threads used by the narrow phase and to solve the islands, 1 (the default) does everything on the calling thread
+void world_set_num_threads(World* world, uint32_t num_threads);
+// 0 (the default) solves the constraints with SOLVE_ITERATIONS iterations and a baumgarte bias. Otherwise
+// each step is split in that many substeps that solve the constraints once with soft constraints, move the
+// bodies and relax the constraints once, which is steadier for stacks (the simd contact solver is not used)
+void world_set_substeps(World* world, uint32_t substeps);
+// simd solving of the contacts is on by default when the cpu supports it
+void world_set_simd(World* world, bool enabled);
 void world_add_force(World* world, Vec2 force);
 void world_add_torque(World* world, float torque);
 void world_update(World* world, float dt);